@@ -25,98 +25,146 @@
 #include "qemu-common.h"
 #include "qemu-aio.h"
 
-/* Anchor of the list of Bottom Halves belonging to the context */
-static struct QEMUBH *first_bh;
-
 /***********************************************************/
 /* bottom halves (can be seen as timers which expire ASAP) */
 
 struct QEMUBH {
     QEMUBHFunc *cb;
     void *opaque;
-    int scheduled;
+    int queued;
     int idle;
+    int cancelled;
     int deleted;
     QEMUBH *next;
 };
 
+/* Scheduled bottom halves, most recently scheduled first.  Any thread
+   may push with a single compare-and-swap; only qemu_bh_poll takes
+   entries off, and it always takes the whole list at once.  */
+static QEMUBH *pending_bh;
+
+/* Bottom halves taken off pending_bh that have not run yet, oldest
+   first.  Only the main loop touches this list, and it is left where a
+   nested qemu_bh_poll (qemu_aio_wait from a callback, for instance) can
+   carry on with it.  */
+static QEMUBH *ready_bh;
+static QEMUBH **ready_bh_tail = &ready_bh;
+
+/* Set once the main loop has been woken up for the current batch.  */
+static int pending_bh_notified;
+
 QEMUBH *qemu_bh_new(QEMUBHFunc *cb, void *opaque)
 {
     QEMUBH *bh;
     bh = g_malloc0(sizeof(QEMUBH));
     bh->cb = cb;
     bh->opaque = opaque;
-    bh->next = first_bh;
-    first_bh = bh;
     return bh;
 }
 
 int qemu_bh_poll(void)
 {
-    QEMUBH *bh, **bhp, *next;
+    QEMUBH *bh, *next, *list, *last;
     int ret;
 
-    ret = 0;
-    for (bh = first_bh; bh; bh = next) {
+    __sync_lock_release(&pending_bh_notified);
+    __sync_synchronize();
+    bh = __sync_lock_test_and_set(&pending_bh, NULL);
+
+    /* queue them behind the ones still waiting, in scheduling order */
+    list = NULL;
+    last = bh;
+    while (bh) {
         next = bh->next;
-        if (!bh->deleted && bh->scheduled) {
-            bh->scheduled = 0;
-            if (!bh->idle)
-                ret = 1;
-            bh->idle = 0;
-            bh->cb(bh->opaque);
-        }
+        bh->next = list;
+        list = bh;
+        bh = next;
+    }
+    if (list) {
+        *ready_bh_tail = list;
+        ready_bh_tail = &last->next;
     }
 
-    /* remove deleted bhs */
-    bhp = &first_bh;
-    while (*bhp) {
-        bh = *bhp;
+    ret = 0;
+    while (ready_bh) {
+        bh = ready_bh;
+        ready_bh = bh->next;
+        if (!ready_bh) {
+            ready_bh_tail = &ready_bh;
+        }
         if (bh->deleted) {
-            *bhp = bh->next;
             g_free(bh);
-        } else
-            bhp = &bh->next;
+            continue;
+        }
+        /* the callback may schedule or delete the bh again */
+        __sync_lock_release(&bh->queued);
+        __sync_synchronize();
+        if (bh->cancelled) {
+            continue;
+        }
+        if (!bh->idle)
+            ret = 1;
+        bh->cb(bh->opaque);
     }
 
     return ret;
 }
 
+/* Returns true if the main loop needs to be woken up.  */
+static int qemu_bh_enqueue(QEMUBH *bh, int idle)
+{
+    QEMUBH *old;
+
+    bh->cancelled = 0;
+    if (__sync_lock_test_and_set(&bh->queued, 1)) {
+        /* already pending, possibly as an idle bh that needs a wakeup */
+        if (idle) {
+            return 0;
+        }
+        bh->idle = 0;
+        return !__sync_lock_test_and_set(&pending_bh_notified, 1);
+    }
+    bh->idle = idle;
+    do {
+        old = pending_bh;
+        bh->next = old;
+    } while (!__sync_bool_compare_and_swap(&pending_bh, old, bh));
+
+    return !idle && !__sync_lock_test_and_set(&pending_bh_notified, 1);
+}
+
 void qemu_bh_schedule_idle(QEMUBH *bh)
 {
-    if (bh->scheduled)
-        return;
-    bh->scheduled = 1;
-    bh->idle = 1;
+    qemu_bh_enqueue(bh, 1);
 }
 
 void qemu_bh_schedule(QEMUBH *bh)
 {
-    if (bh->scheduled)
-        return;
-    bh->scheduled = 1;
-    bh->idle = 0;
-    /* stop the currently executing CPU to execute the BH ASAP */
-    qemu_notify_event();
+    /* stop the currently executing CPU to execute the BH ASAP, unless
+       that was already done for a bh that has not run yet */
+    if (qemu_bh_enqueue(bh, 0)) {
+        qemu_notify_event();
+    }
 }
 
 void qemu_bh_cancel(QEMUBH *bh)
 {
-    bh->scheduled = 0;
+    bh->cancelled = 1;
 }
 
 void qemu_bh_delete(QEMUBH *bh)
 {
-    bh->scheduled = 0;
+    /* a queued bh is freed by qemu_bh_poll */
     bh->deleted = 1;
+    if (!bh->queued) {
+        g_free(bh);
+    }
 }
 
-void qemu_bh_update_timeout(int *timeout)
+static void qemu_bh_list_timeout(QEMUBH *bh, int *timeout)
 {
-    QEMUBH *bh;
-
-    for (bh = first_bh; bh; bh = bh->next) {
-        if (!bh->deleted && bh->scheduled) {
+    for (; bh; bh = bh->next) {
+        if (!bh->deleted && !bh->cancelled) {
             if (bh->idle) {
                 /* idle bottom halves will be polled at least
                  * every 10ms */
@@ -131,3 +179,9 @@ void qemu_bh_update_timeout(int *timeout)
     }
 }
 
+void qemu_bh_update_timeout(int *timeout)
+{
+    qemu_bh_list_timeout(ready_bh, timeout);
+    qemu_bh_list_timeout(pending_bh, timeout);
+}
+
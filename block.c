@@ -1991,6 +1991,52 @@ void bdrv_info_stats(Monitor *mon, QObject **ret_data)
     *ret_data = QOBJECT(devices);
 }
 
+static void bdrv_stats_put(QDict *dict, BlockDriverState *bs,
+                           const char *name, int64_t val)
+{
+    char key[128];
+
+    snprintf(key, sizeof(key), "%s.%s", bs->device_name, name);
+    qdict_put(dict, key, qint_from_int(val));
+}
+
+/* Flat counters for the "block" entry of query-stats.  */
+void bdrv_stats_snapshot(QDict *dict, void *opaque)
+{
+    static const char *acct_names[BDRV_MAX_IOTYPE] = {
+        [BDRV_ACCT_READ] = "rd",
+        [BDRV_ACCT_WRITE] = "wr",
+        [BDRV_ACCT_FLUSH] = "flush",
+    };
+    BlockDriverState *bs;
+    char name[64];
+    int type, i;
+
+    QTAILQ_FOREACH(bs, &bdrv_states, list) {
+        if (!*bs->device_name) {
+            continue;
+        }
+        for (type = 0; type < BDRV_MAX_IOTYPE; type++) {
+            snprintf(name, sizeof(name), "%s_operations", acct_names[type]);
+            bdrv_stats_put(dict, bs, name, bs->nr_ops[type]);
+            snprintf(name, sizeof(name), "%s_bytes", acct_names[type]);
+            bdrv_stats_put(dict, bs, name, bs->nr_bytes[type]);
+            snprintf(name, sizeof(name), "%s_total_time_ns", acct_names[type]);
+            bdrv_stats_put(dict, bs, name, bs->total_time_ns[type]);
+            for (i = 0; i < BDRV_LATENCY_BUCKETS; i++) {
+                if (i < BDRV_LATENCY_BUCKETS - 1) {
+                    snprintf(name, sizeof(name), "%s_latency_lt_%dus",
+                             acct_names[type], 64 << (2 * i));
+                } else {
+                    snprintf(name, sizeof(name), "%s_latency_ge_%dus",
+                             acct_names[type], 64 << (2 * (i - 1)));
+                }
+                bdrv_stats_put(dict, bs, name, bs->latency_hist[type][i]);
+            }
+        }
+    }
+}
+
 const char *bdrv_get_encrypted_filename(BlockDriverState *bs)
 {
     if (bs->backing_hd && bs->backing_hd->encrypted)
@@ -3179,11 +3225,21 @@ bdrv_acct_start(BlockDriverState *bs, BlockAcctCookie *cookie, int64_t bytes,
 void
 bdrv_acct_done(BlockDriverState *bs, BlockAcctCookie *cookie)
 {
+    int64_t latency;
+    int bucket;
+
     assert(cookie->type < BDRV_MAX_IOTYPE);
 
+    latency = get_clock() - cookie->start_time_ns;
     bs->nr_bytes[cookie->type] += cookie->bytes;
     bs->nr_ops[cookie->type]++;
-    bs->total_time_ns[cookie->type] += get_clock() - cookie->start_time_ns;
+    bs->total_time_ns[cookie->type] += latency;
+
+    latency /= 64 * 1000;
+    for (bucket = 0; latency && bucket < BDRV_LATENCY_BUCKETS - 1; bucket++) {
+        latency >>= 2;
+    }
+    bs->latency_hist[cookie->type][bucket]++;
 }
 
 int bdrv_img_create(const char *filename, const char *fmt,
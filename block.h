@@ -6,6 +6,7 @@
 #include "qemu-option.h"
 #include "qemu-coroutine.h"
 #include "qobject.h"
+#include "qdict.h"
 
 /* block.c */
 typedef struct BlockDriver BlockDriver;
@@ -57,6 +58,7 @@ void bdrv_info_print(Monitor *mon, const QObject *data);
 void bdrv_info(Monitor *mon, QObject **ret_data);
 void bdrv_stats_print(Monitor *mon, const QObject *data);
 void bdrv_info_stats(Monitor *mon, QObject **ret_data);
+void bdrv_stats_snapshot(QDict *dict, void *opaque);
 
 void bdrv_init(void);
 void bdrv_init_with_whitelist(void);
@@ -262,6 +264,9 @@ enum BlockAcctType {
     BDRV_MAX_IOTYPE,
 };
 
+/* Request latency histogram buckets, x4 apart starting below 64us.  */
+#define BDRV_LATENCY_BUCKETS 8
+
 typedef struct BlockAcctCookie {
     int64_t bytes;
     int64_t start_time_ns;
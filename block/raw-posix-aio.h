@@ -27,6 +27,7 @@
 
 /* posix-aio-compat.c - thread pool based implementation */
 int paio_init(void);
+int paio_fork_child(void);
 BlockDriverAIOCB *paio_submit(BlockDriverState *bs, int fd,
         int64_t sector_num, QEMUIOVector *qiov, int nb_sectors,
         BlockDriverCompletionFunc *cb, void *opaque, int type);
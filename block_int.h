@@ -188,6 +188,7 @@ struct BlockDriverState {
     uint64_t nr_bytes[BDRV_MAX_IOTYPE];
     uint64_t nr_ops[BDRV_MAX_IOTYPE];
     uint64_t total_time_ns[BDRV_MAX_IOTYPE];
+    uint64_t latency_hist[BDRV_MAX_IOTYPE][BDRV_LATENCY_BUCKETS];
     uint64_t wr_highest_sector;
 
     /* Whether the disk can expand beyond total_sectors */
@@ -457,6 +457,7 @@ extern const CPULogItem cpu_log_items[];
 
 void cpu_set_log(int log_flags);
 void cpu_set_log_filename(const char *filename);
+void cpu_set_log_fork_child(void);
 int cpu_str_to_log_mask(const char *str);
 
 #if !defined(CONFIG_USER_ONLY)
@@ -473,6 +474,8 @@ extern ram_addr_t ram_size;
 
 /* RAM is pre-allocated and passed into qemu_ram_alloc_from_ptr */
 #define RAM_PREALLOC_MASK   (1 << 0)
+/* host memory was mmapped by qemu_ram_alloc, see -machine mem-* */
+#define RAM_MMAP_MASK       (1 << 1)
 
 typedef struct RAMBlock {
     uint8_t *host;
@@ -496,6 +499,9 @@ extern RAMList ram_list;
 
 extern const char *mem_path;
 extern int mem_prealloc;
+extern int mem_hugepage;
+extern int mem_shared;
+extern int mem_host_node;
 
 /* physical memory access */
 
@@ -110,12 +110,25 @@ typedef struct CPUTLBEntry {
 
 extern int CPUTLBEntry_wrong_size[sizeof(CPUTLBEntry) == (1 << CPU_TLB_ENTRY_BITS) ? 1 : -1];
 
+/* Code pages recently resolved by get_page_addr_code(), so that TB
+   lookups skip the TLB probe and the RAM block walk.  Entries are
+   dropped together with the TLB.  */
+#define CPU_CODE_PAGE_BITS 4
+#define CPU_CODE_PAGE_SIZE (1 << CPU_CODE_PAGE_BITS)
+
+typedef struct CPUCodePageEntry {
+    target_ulong vaddr;
+    int mmu_idx;
+    uint64_t ram_addr; /* ram_addr_t of the start of the page */
+} CPUCodePageEntry;
+
 #define CPU_COMMON_TLB \
     /* The meaning of the MMU modes is defined in the target code. */   \
     CPUTLBEntry tlb_table[NB_MMU_MODES][CPU_TLB_SIZE];                  \
     target_phys_addr_t iotlb[NB_MMU_MODES][CPU_TLB_SIZE];               \
     target_ulong tlb_flush_addr;                                        \
-    target_ulong tlb_flush_mask;
+    target_ulong tlb_flush_mask;                                        \
+    CPUCodePageEntry code_page_cache[CPU_CODE_PAGE_SIZE];
 
 #else
 
@@ -181,6 +194,7 @@ typedef struct CPUWatchpoint {
         icount_decr_u16 u16;                                            \
     } icount_decr;                                                      \
     uint32_t can_do_io; /* nonzero if memory mapped IO is safe.  */     \
+    int io_icount_credit; /* see cpu_io_icount_begin, -1 if none.  */   \
                                                                         \
     /* from this point: preserved by CPU reset */                       \
     /* ice debug support */                                             \
@@ -64,7 +64,7 @@ static void cpu_exec_nocache(CPUState *env, int max_cycles,
         max_cycles = CF_COUNT_MASK;
 
     tb = tb_gen_code(env, orig_tb->pc, orig_tb->cs_base, orig_tb->flags,
-                     max_cycles);
+                     max_cycles | CF_NOCACHE);
     env->current_tb = tb;
     /* execute the generated code */
     next_tb = tcg_qemu_tb_exec(env, tb->tc_ptr);
@@ -90,6 +90,7 @@ static TranslationBlock *tb_find_slow(CPUState *env,
     target_ulong virt_page2;
 
     tb_invalidated_flag = 0;
+    tb_lookup_slow_count++;
 
     /* find translated block using physical mappings */
     phys_pc = get_page_addr_code(env, pc);
@@ -152,6 +153,33 @@ static inline TranslationBlock *tb_find_fast(CPUState *env)
     return tb;
 }
 
+/* Find the TB for the CPU state at the end of the current one without
+   leaving the code cache.  Translated code jumps straight to the result,
+   or exits to cpu_exec() if it is NULL.  Only the jump cache is probed,
+   and its entries are dropped whenever the virtual to physical mapping
+   changes, so this also covers jumps to another page.  */
+void *helper_lookup_tb_ptr(CPUState *env)
+{
+    TranslationBlock *tb;
+    target_ulong cs_base, pc;
+    int flags;
+
+    cpu_get_tb_cpu_state(env, &pc, &cs_base, &flags);
+    tb = env->tb_jmp_cache[tb_jmp_cache_hash_func(pc)];
+    if (unlikely(!tb || tb->pc != pc || tb->cs_base != cs_base ||
+                 tb->flags != flags)) {
+        return NULL;
+    }
+    /* Same ordering as in cpu_exec(): once TB is current, cpu_interrupt
+       unchains it, otherwise we see the request here.  */
+    env->current_tb = tb;
+    barrier();
+    if (unlikely(env->exit_request || env->interrupt_request)) {
+        return NULL;
+    }
+    return tb->tc_ptr;
+}
+
 static CPUDebugExcpHandler *debug_excp_handler;
 
 CPUDebugExcpHandler *cpu_set_debug_excp_handler(CPUDebugExcpHandler *handler)
@@ -533,9 +561,9 @@ int cpu_exec(CPUState *env)
                     tb_invalidated_flag = 0;
                 }
 #ifdef CONFIG_DEBUG_EXEC
-                qemu_log_mask(CPU_LOG_EXEC, "Trace 0x%08lx [" TARGET_FMT_lx "] %s\n",
-                             (long)tb->tc_ptr, tb->pc,
-                             lookup_symbol(tb->pc));
+                if (qemu_loglevel_mask(CPU_LOG_EXEC)) {
+                    cpu_log_exec(tb);
+                }
 #endif
                 /* see if we can patch the calling TB. When the TB
                    spans two pages, we cannot safely do a direct
@@ -591,6 +619,11 @@ int cpu_exec(CPUState *env)
             /* Reload env after longjmp - the compiler may have smashed all
              * local variables as longjmp is marked 'noreturn'. */
             env = cpu_single_env;
+            /* An I/O access that left the TB this way did not get to
+               take back its icount credit.  */
+            if (env->io_icount_credit >= 0) {
+                cpu_io_icount_end(env, env->io_icount_credit);
+            }
         }
     } /* for(;;) */
 
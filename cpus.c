@@ -285,6 +285,12 @@ static void qemu_kvm_eat_signals(CPUState *env)
 
 #ifndef _WIN32
 static int io_thread_fd = -1;
+static int io_thread_rfd = -1;
+static int signal_fd = -1;
+
+/* Set from the first notification until qemu_event_read drains the fd,
+   further notifications in between need no write.  */
+static int io_thread_event_pending;
 
 static void qemu_event_increment(void)
 {
@@ -295,6 +301,9 @@ static void qemu_event_increment(void)
     if (io_thread_fd == -1) {
         return;
     }
+    if (__sync_lock_test_and_set(&io_thread_event_pending, 1)) {
+        return;
+    }
     do {
         ret = write(io_thread_fd, &val, sizeof(val));
     } while (ret < 0 && errno == EINTR);
@@ -317,6 +326,13 @@ static void qemu_event_read(void *opaque)
     do {
         len = read(fd, buffer, sizeof(buffer));
     } while ((len == -1 && errno == EINTR) || len == sizeof(buffer));
+
+    /* Only rearm after draining, otherwise a write could be eaten while
+       later notifications are still being suppressed.  Whatever a
+       notifier queued in between is picked up by this main loop
+       iteration.  */
+    __sync_lock_release(&io_thread_event_pending);
+    __sync_synchronize();
 }
 
 static int qemu_event_init(void)
@@ -339,6 +355,7 @@ static int qemu_event_init(void)
     qemu_set_fd_handler2(fds[0], NULL, qemu_event_read, NULL,
                          (void *)(intptr_t)fds[0]);
 
+    io_thread_rfd = fds[0];
     io_thread_fd = fds[1];
     return 0;
 
@@ -436,6 +453,7 @@ static int qemu_signal_init(void)
     qemu_set_fd_handler2(sigfd, NULL, sigfd_handler, NULL,
                          (void *)(intptr_t)sigfd);
 
+    signal_fd = sigfd;
     return 0;
 }
 
@@ -552,6 +570,35 @@ int qemu_init_main_loop(void)
     return qemu_event_init();
 }
 
+#ifndef _WIN32
+/* Rebuild the main loop notifiers in a child forked from a running
+   instance.  The inherited descriptors are shared with the parent, which
+   would lose wakeups and signals that the child consumed, and the thread
+   behind a compat signalfd is not carried over by fork().  */
+int qemu_init_main_loop_child(void)
+{
+    int ret;
+
+    qemu_set_fd_handler2(signal_fd, NULL, NULL, NULL, NULL);
+    close(signal_fd);
+    signal_fd = -1;
+
+    qemu_set_fd_handler2(io_thread_rfd, NULL, NULL, NULL, NULL);
+    close(io_thread_rfd);
+    if (io_thread_fd != io_thread_rfd) {
+        close(io_thread_fd);
+    }
+    io_thread_fd = io_thread_rfd = -1;
+    io_thread_event_pending = 0;
+
+    ret = qemu_signal_init();
+    if (ret) {
+        return ret;
+    }
+    return qemu_event_init();
+}
+#endif
+
 void qemu_main_loop_start(void)
 {
 }
@@ -1003,6 +1050,12 @@ void qemu_init_vcpu(void *_env)
 
 void qemu_notify_event(void)
 {
+    /* The iothread is not blocked in select() when it gets here and goes
+       through the main loop before it waits again, so waking it up from
+       itself would just cost a write and a read.  */
+    if (qemu_thread_is_self(&io_thread)) {
+        return;
+    }
     qemu_event_increment();
 }
 
@@ -1106,6 +1159,7 @@ bool cpu_exec_all(void)
             break;
         }
     }
+    tlm_flush_posted_writes();
     if (tlm_sync) {
         tlm_sync(tlm_opaque, qemu_get_clock_ns(vm_clock));
     }
@@ -3,6 +3,7 @@
 
 /* cpus.c */
 int qemu_init_main_loop(void);
+int qemu_init_main_loop_child(void);
 void qemu_main_loop_start(void);
 void resume_all_vcpus(void);
 void pause_all_vcpus(void);
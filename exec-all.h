@@ -86,8 +86,12 @@ int cpu_gen_code(CPUState *env, struct TranslationBlock *tb,
                  int *gen_code_size_ptr);
 int cpu_restore_state(struct TranslationBlock *tb,
                       CPUState *env, unsigned long searched_pc);
+int cpu_restore_icount(struct TranslationBlock *tb,
+                       CPUState *env, unsigned long searched_pc);
 void cpu_resume_from_signal(CPUState *env1, void *puc);
 void cpu_io_recompile(CPUState *env, void *retaddr);
+int cpu_io_icount_begin(CPUState *env, void *retaddr);
+void cpu_io_icount_end(CPUState *env, int credit);
 TranslationBlock *tb_gen_code(CPUState *env, 
                               target_ulong pc, target_ulong cs_base, int flags,
                               int cflags);
@@ -130,9 +134,10 @@ struct TranslationBlock {
     uint64_t flags; /* flags defining in which context the code was generated */
     uint16_t size;      /* size of target code for this block (1 <=
                            size <= TARGET_PAGE_SIZE) */
-    uint16_t cflags;    /* compile flags */
+    uint32_t cflags;    /* compile flags */
 #define CF_COUNT_MASK  0x7fff
 #define CF_LAST_IO     0x8000 /* Last insn may be an IO access.  */
+#define CF_NOCACHE     0x10000 /* To be freed after execution */
 
     uint8_t *tc_ptr;    /* pointer to the translated code */
     /* next matching tb for physical address. */
@@ -181,6 +186,7 @@ static inline unsigned int tb_phys_hash_func(tb_page_addr_t pc)
 
 void tb_free(TranslationBlock *tb);
 void tb_flush(CPUState *env);
+void cpu_log_exec(TranslationBlock *tb);
 void tb_link_page(TranslationBlock *tb,
                   tb_page_addr_t phys_pc, tb_page_addr_t phys_page2);
 void tb_phys_invalidate(TranslationBlock *tb, tb_page_addr_t page_addr);
@@ -260,12 +266,14 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
 }
 
 TranslationBlock *tb_find_pc(unsigned long pc_ptr);
+void *helper_lookup_tb_ptr(CPUState *env);
 
 #include "qemu-lock.h"
 
 extern spinlock_t tb_lock;
 
 extern int tb_invalidated_flag;
+extern uint64_t tb_lookup_slow_count;
 
 #if !defined(CONFIG_USER_ONLY)
 
@@ -307,16 +315,26 @@ static inline tb_page_addr_t get_page_addr_code(CPUState *env1, target_ulong add
 }
 #else
 int tlm_iodev_is_ram(int iodev);
+int tlm_iodev_is_tlm(int iodev);
 /* NOTE: this function can trigger an exception */
 /* NOTE2: the returned address is not exactly the physical address: it
    is the offset relative to phys_ram_base */
 static inline tb_page_addr_t get_page_addr_code(CPUState *env1, target_ulong addr)
 {
     int mmu_idx, page_index, pd;
+    CPUCodePageEntry *ent;
+    tb_page_addr_t ret;
     void *p;
 
-    page_index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
     mmu_idx = cpu_mmu_index(env1);
+    ent = &env1->code_page_cache[(addr >> TARGET_PAGE_BITS) &
+                                 (CPU_CODE_PAGE_SIZE - 1)];
+    if (likely(ent->vaddr == (addr & TARGET_PAGE_MASK) &&
+               ent->mmu_idx == mmu_idx)) {
+        return ent->ram_addr + (addr & ~TARGET_PAGE_MASK);
+    }
+
+    page_index = (addr >> TARGET_PAGE_BITS) & (CPU_TLB_SIZE - 1);
     if (unlikely(env1->tlb_table[mmu_idx][page_index].addr_code !=
                  (addr & TARGET_PAGE_MASK))) {
         ldub_code(addr);
@@ -333,7 +351,8 @@ static inline tb_page_addr_t get_page_addr_code(CPUState *env1, target_ulong add
              RAMBlock *block;
              QLIST_FOREACH(block, &ram_list.blocks, next){
                  if(paddr == (block->TLM.iodev >> IO_MEM_SHIFT)){
-                     return block->offset + (uintptr_t)(addr) + env1->tlb_table[mmu_idx][page_index].addend - (uintptr_t)(block->host);
+                     ret = block->offset + (uintptr_t)(addr) + env1->tlb_table[mmu_idx][page_index].addend - (uintptr_t)(block->host);
+                     goto found;
                  }
              }
              fprintf(stderr, "Bad ram pointer %llx\n", (unsigned long long)addr);
@@ -345,7 +364,12 @@ static inline tb_page_addr_t get_page_addr_code(CPUState *env1, target_ulong add
     }
     p = (void *)(unsigned long)addr
         + env1->tlb_table[mmu_idx][page_index].addend;
-    return qemu_ram_addr_from_host_nofail(p);
+    ret = qemu_ram_addr_from_host_nofail(p);
+ found:
+    ent->vaddr = addr & TARGET_PAGE_MASK;
+    ent->mmu_idx = mmu_idx;
+    ent->ram_addr = ret - (addr & ~TARGET_PAGE_MASK);
+    return ret;
 }
 #endif
 
@@ -23,6 +23,9 @@
 #include <sys/types.h>
 #include <sys/mman.h>
 #endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include "qemu-common.h"
 #include "cpu.h"
@@ -35,6 +38,7 @@
 #include "qemu-timer.h"
 #include "memory.h"
 #include "exec-memory.h"
+#include "disas.h"
 #if defined(CONFIG_USER_ONLY)
 #include <qemu.h>
 #if defined(__FreeBSD__) || defined(__FreeBSD_kernel__)
@@ -55,6 +59,11 @@
 #else /* !CONFIG_USER_ONLY */
 #include "xen-mapcache.h"
 #include "trace.h"
+#include "qemu-stats.h"
+#include "qemu-thread.h"
+#ifdef CONFIG_LINUX
+#include <stdio_ext.h>
+#endif
 #endif
 
 //#define DEBUG_TB_INVALIDATE
@@ -226,9 +235,31 @@ static int log_append = 0;
 /* statistics */
 #if !defined(CONFIG_USER_ONLY)
 static int tlb_flush_count;
+static uint64_t tlb_fill_count;
 #endif
 static int tb_flush_count;
 static int tb_phys_invalidate_count;
+uint64_t tb_lookup_slow_count;
+
+/* Number of instructions left in the TB after an I/O access, keyed by the
+   host return address of the access. Host code is reused after tb_flush,
+   and by the next TB when tb_free backs up code_gen_ptr.  */
+#define IO_ICOUNT_CACHE_SIZE 256
+static struct {
+    unsigned long pc;
+    int left;
+} io_icount_cache[IO_ICOUNT_CACHE_SIZE];
+
+static void io_icount_cache_drop(unsigned long start, unsigned long end)
+{
+    int i;
+
+    for (i = 0; i < IO_ICOUNT_CACHE_SIZE; i++) {
+        if (io_icount_cache[i].pc >= start && io_icount_cache[i].pc < end) {
+            io_icount_cache[i].pc = 0;
+        }
+    }
+}
 
 #ifdef _WIN32
 static void map_exec(void *addr, long size)
@@ -590,11 +621,28 @@ bool tcg_enabled(void)
     return code_gen_buffer != NULL;
 }
 
+#if !defined(CONFIG_USER_ONLY)
+static void exec_stats(QDict *dict, void *opaque)
+{
+    qemu_stats_put(dict, NULL, "tb_count", nb_tbs);
+    qemu_stats_put(dict, NULL, "tb_max", code_gen_max_blocks);
+    qemu_stats_put(dict, NULL, "code_size", code_gen_ptr - code_gen_buffer);
+    qemu_stats_put(dict, NULL, "code_max", code_gen_buffer_max_size);
+    qemu_stats_put(dict, NULL, "tb_flush_count", tb_flush_count);
+    qemu_stats_put(dict, NULL, "tb_invalidate_count",
+                   tb_phys_invalidate_count);
+    qemu_stats_put(dict, NULL, "tb_lookup_slow_count", tb_lookup_slow_count);
+    qemu_stats_put(dict, NULL, "tlb_flush_count", tlb_flush_count);
+    qemu_stats_put(dict, NULL, "tlb_fill_count", tlb_fill_count);
+}
+#endif
+
 void cpu_exec_init_all(void)
 {
 #if !defined(CONFIG_USER_ONLY)
     memory_map_init();
     io_mem_init();
+    qemu_stats_register("exec", exec_stats, NULL);
 #endif
 }
 
@@ -656,6 +704,7 @@ void cpu_exec_init(CPUState *env)
     }
     env->cpu_index = cpu_index;
     env->numa_node = 0;
+    env->io_icount_credit = -1;
     QTAILQ_INIT(&env->breakpoints);
     QTAILQ_INIT(&env->watchpoints);
 #ifndef CONFIG_USER_ONLY
@@ -693,6 +742,8 @@ void tb_free(TranslationBlock *tb)
        Ignore the hard cases and just back up if this TB happens to
        be the last one generated.  */
     if (nb_tbs > 0 && tb == &tbs[nb_tbs - 1]) {
+        io_icount_cache_drop((unsigned long)tb->tc_ptr,
+                             (unsigned long)code_gen_ptr);
         code_gen_ptr = tb->tc_ptr;
         nb_tbs--;
     }
@@ -765,6 +816,7 @@ void tb_flush(CPUState *env1)
     /* XXX: flush processor icache at this point if cache flush is
        expensive */
     tb_flush_count++;
+    memset(io_icount_cache, 0, sizeof io_icount_cache);
 }
 
 #ifdef DEBUG_TB_CHECK
@@ -1595,11 +1647,321 @@ void cpu_single_step(CPUState *env, int enabled)
 #endif
 }
 
+#if defined(CONFIG_SOFTMMU) && defined(CONFIG_LINUX)
+/* The log stream hands its output to a ring that a separate thread
+   writes out, so that heavy -d tracing does not stall the vCPU on a
+   write(2) per line.  The stream is still a FILE so that all the
+   existing cpu_dump_state/disas users keep working.
+
+   The ring holds frames: text from the stream, or raw records that the
+   writer formats, see cpu_log_exec.  The vCPU only wakes the writer
+   once a batch is pending or when the writer has gone idle; otherwise
+   the writer picks up what is pending every LOG_RING_FLUSH_MS.  */
+#define LOG_RING_SIZE (4 * 1024 * 1024)
+#define LOG_RING_OUT_SIZE (64 * 1024)
+#define LOG_RING_BATCH (LOG_RING_OUT_SIZE / 2)
+#define LOG_RING_FLUSH_MS 100
+/* the largest text payload, and the largest formatted record */
+#define LOG_FRAME_MAX 4096
+
+enum {
+    LOG_FRAME_TEXT,
+    LOG_FRAME_EXEC,
+};
+
+typedef struct LogFrame {
+    uint32_t type;
+    uint32_t len;
+} LogFrame;
+
+typedef struct LogExecRecord {
+    uintptr_t tc_ptr;
+    target_ulong pc;
+} LogExecRecord;
+
+typedef struct LogRing {
+    int fd;
+    FILE *file;
+    char *buf;
+    char *out;
+    size_t head;  /* bytes produced so far */
+    size_t tail;  /* bytes written out so far */
+    int idle;     /* writer waits for the first byte */
+    int kicked;   /* writer was signalled since it last woke */
+    int closing;
+    int done;
+    int started;
+    QemuMutex lock;
+    QemuCond produced;
+    QemuCond consumed;
+    QemuThread thread;
+} LogRing;
+
+/* The ring behind logfile, for cpu_log_exec.  */
+static LogRing *log_ring_current;
+
+static void log_ring_copy_out(LogRing *r, size_t pos, void *data, size_t len)
+{
+    size_t start = pos % LOG_RING_SIZE;
+    size_t part = MIN(len, LOG_RING_SIZE - start);
+
+    memcpy(data, r->buf + start, part);
+    memcpy((char *)data + part, r->buf, len - part);
+}
+
+static void log_ring_copy_in(LogRing *r, const void *data, size_t len)
+{
+    size_t start = r->head % LOG_RING_SIZE;
+    size_t part = MIN(len, LOG_RING_SIZE - start);
+
+    memcpy(r->buf + start, data, part);
+    memcpy(r->buf, (const char *)data + part, len - part);
+    r->head += len;
+}
+
+/* Called with the lock held.  */
+static void log_ring_kick(LogRing *r)
+{
+    if (!r->kicked && (r->idle || r->head - r->tail >= LOG_RING_BATCH)) {
+        r->kicked = 1;
+        qemu_cond_signal(&r->produced);
+    }
+}
+
+/* Append one frame, waiting for room if the writer is behind.  Called
+   with the lock held.  */
+static void log_ring_put(LogRing *r, uint32_t type, const void *data,
+                         uint32_t len)
+{
+    LogFrame frame = { .type = type, .len = len };
+
+    while (LOG_RING_SIZE - (r->head - r->tail) < sizeof(frame) + len) {
+        log_ring_kick(r);
+        qemu_cond_wait(&r->consumed, &r->lock);
+    }
+    log_ring_copy_in(r, &frame, sizeof(frame));
+    log_ring_copy_in(r, data, len);
+    log_ring_kick(r);
+}
+
+/* Turn the frames from @pos up to @head into text in r->out, as many as
+   fit.  Returns the ring position after the last frame taken.  */
+static size_t log_ring_format(LogRing *r, size_t pos, size_t head,
+                              size_t *out_len)
+{
+    size_t n = 0;
+    LogFrame frame;
+    LogExecRecord rec;
+    int len;
+
+    while (pos < head && n + LOG_FRAME_MAX <= LOG_RING_OUT_SIZE) {
+        log_ring_copy_out(r, pos, &frame, sizeof(frame));
+        pos += sizeof(frame);
+        switch (frame.type) {
+        case LOG_FRAME_TEXT:
+            log_ring_copy_out(r, pos, r->out + n, frame.len);
+            n += frame.len;
+            break;
+        case LOG_FRAME_EXEC:
+            /* the symbol tables only grow while images are loaded */
+            log_ring_copy_out(r, pos, &rec, sizeof(rec));
+            len = snprintf(r->out + n, LOG_FRAME_MAX,
+                           "Trace 0x%08lx [" TARGET_FMT_lx "] %s\n",
+                           (long)rec.tc_ptr, rec.pc, lookup_symbol(rec.pc));
+            if (len > 0) {
+                n += MIN(len, LOG_FRAME_MAX - 1);
+            }
+            break;
+        }
+        pos += frame.len;
+    }
+    *out_len = n;
+    return pos;
+}
+
+static void *log_ring_thread(void *opaque)
+{
+    LogRing *r = opaque;
+    size_t head, next, len, done;
+    ssize_t ret;
+
+    qemu_mutex_lock(&r->lock);
+    for (;;) {
+        if (r->head == r->tail && !r->closing) {
+            r->idle = 1;
+            r->kicked = 0;
+            qemu_cond_wait(&r->produced, &r->lock);
+            r->idle = 0;
+        }
+        /* give a trickle of lines the chance to become a batch */
+        if (r->head - r->tail < LOG_RING_BATCH && !r->closing) {
+            r->kicked = 0;
+            qemu_cond_timedwait(&r->produced, &r->lock, LOG_RING_FLUSH_MS);
+        }
+        if (r->head == r->tail) {
+            if (r->closing) {
+                break;
+            }
+            continue;
+        }
+        /* only the writer moves tail, and nobody writes behind head */
+        head = r->head;
+        qemu_mutex_unlock(&r->lock);
+        next = log_ring_format(r, r->tail, head, &len);
+        for (done = 0; done < len; done += ret) {
+            ret = write(r->fd, r->out + done, len - done);
+            if (ret < 0 && errno == EINTR) {
+                ret = 0;
+            } else if (ret <= 0) {
+                /* drop what cannot be written rather than stall the guest */
+                break;
+            }
+        }
+        qemu_mutex_lock(&r->lock);
+        r->tail = next;
+        qemu_cond_broadcast(&r->consumed);
+    }
+    r->done = 1;
+    qemu_cond_broadcast(&r->consumed);
+    qemu_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+static ssize_t log_ring_write(void *cookie, const char *data, size_t size)
+{
+    LogRing *r = cookie;
+    size_t done, len;
+
+    qemu_mutex_lock(&r->lock);
+    for (done = 0; done < size; done += len) {
+        len = MIN(size - done, LOG_FRAME_MAX);
+        log_ring_put(r, LOG_FRAME_TEXT, data + done, len);
+    }
+    qemu_mutex_unlock(&r->lock);
+    return size;
+}
+
+static int log_ring_close(void *cookie)
+{
+    LogRing *r = cookie;
+
+    qemu_mutex_lock(&r->lock);
+    r->closing = 1;
+    qemu_cond_signal(&r->produced);
+    while (!r->done) {
+        qemu_cond_wait(&r->consumed, &r->lock);
+    }
+    qemu_mutex_unlock(&r->lock);
+    if (r->started) {
+        qemu_thread_join(&r->thread);
+    }
+    if (log_ring_current == r) {
+        log_ring_current = NULL;
+    }
+
+    close(r->fd);
+    qemu_mutex_destroy(&r->lock);
+    qemu_cond_destroy(&r->produced);
+    qemu_cond_destroy(&r->consumed);
+    g_free(r->out);
+    g_free(r->buf);
+    g_free(r);
+    return 0;
+}
+
+static FILE *log_ring_open(const char *filename, int append)
+{
+    static const cookie_io_functions_t log_ring_io = {
+        .write = log_ring_write,
+        .close = log_ring_close,
+    };
+    LogRing *r;
+    FILE *f;
+    int fd;
+
+    fd = open(filename, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC),
+              0666);
+    if (fd < 0) {
+        return NULL;
+    }
+    r = g_malloc0(sizeof(*r));
+    r->fd = fd;
+    r->buf = g_malloc(LOG_RING_SIZE);
+    r->out = g_malloc(LOG_RING_OUT_SIZE);
+    qemu_mutex_init(&r->lock);
+    qemu_cond_init(&r->produced);
+    qemu_cond_init(&r->consumed);
+
+    f = fopencookie(r, "w", log_ring_io);
+    if (!f) {
+        /* no writer thread to wait for */
+        r->done = 1;
+        log_ring_close(r);
+        return NULL;
+    }
+    /* Lines only go as far as the ring, which costs a memcpy under an
+       uncontended lock, so cpu_abort and exit lose nothing.  */
+    setvbuf(f, NULL, _IOLBF, 0);
+    r->file = f;
+    qemu_thread_create(&r->thread, log_ring_thread, r);
+    r->started = 1;
+    log_ring_current = r;
+    return f;
+}
+
+/* The writer thread may be behind, write out the tail of the log.  */
+static void log_ring_atexit(void)
+{
+    if (logfile) {
+        qemu_log_close();
+    }
+}
+#endif
+
+/* -d exec trace line for @tb.  It is logged once per TB entry, so on a
+   ring stream only the raw values are stored and the writer thread does
+   the formatting and the symbol lookup.  */
+void cpu_log_exec(TranslationBlock *tb)
+{
+#if defined(CONFIG_SOFTMMU) && defined(CONFIG_LINUX)
+    LogRing *r = log_ring_current;
+    LogExecRecord rec;
+
+    if (r && r->file == logfile) {
+        /* text the stream still buffers goes first */
+        if (__fpending(logfile)) {
+            fflush(logfile);
+        }
+        rec.tc_ptr = (uintptr_t)tb->tc_ptr;
+        rec.pc = tb->pc;
+        qemu_mutex_lock(&r->lock);
+        log_ring_put(r, LOG_FRAME_EXEC, &rec, sizeof(rec));
+        qemu_mutex_unlock(&r->lock);
+        return;
+    }
+#endif
+    qemu_log("Trace 0x%08lx [" TARGET_FMT_lx "] %s\n",
+             (long)tb->tc_ptr, tb->pc, lookup_symbol(tb->pc));
+}
+
 /* enable or disable low levels log */
 void cpu_set_log(int log_flags)
 {
     loglevel = log_flags;
     if (loglevel && !logfile) {
+#if defined(CONFIG_SOFTMMU) && defined(CONFIG_LINUX)
+        static int log_ring_atexit_done;
+
+        if (!log_ring_atexit_done) {
+            atexit(log_ring_atexit);
+            log_ring_atexit_done = 1;
+        }
+        logfile = log_ring_open(logfilename, log_append);
+        if (logfile) {
+            log_append = 1;
+            return;
+        }
+#endif
         logfile = fopen(logfilename, log_append ? "a" : "w");
         if (!logfile) {
             perror(logfilename);
@@ -1633,6 +1995,27 @@ void cpu_set_log_filename(const char *filename)
     cpu_set_log(loglevel);
 }
 
+/* Give a forked child a log of its own, named after its pid.  The
+   inherited stream is dropped without being flushed: whatever it buffers
+   is the parent's to write, and the writer thread of a ring stream did
+   not survive the fork anyway.  */
+void cpu_set_log_fork_child(void)
+{
+    char *name;
+
+    if (!logfile) {
+        return;
+    }
+    logfile = NULL;
+#if defined(CONFIG_SOFTMMU) && defined(CONFIG_LINUX)
+    log_ring_current = NULL;
+#endif
+    name = g_strdup_printf("%s.%d", logfilename, (int)getpid());
+    logfilename = name;
+    log_append = 0;
+    cpu_set_log(loglevel);
+}
+
 static void cpu_unlink_tb(CPUState *env)
 {
     /* FIXME: TB unchaining isn't SMP safe.  For now just ignore the
@@ -2014,6 +2397,10 @@ void tlb_flush(CPUState *env, int flush_global)
 
     memset (env->tb_jmp_cache, 0, TB_JMP_CACHE_SIZE * sizeof (void *));
 
+    for (i = 0; i < CPU_CODE_PAGE_SIZE; i++) {
+        env->code_page_cache[i].vaddr = -1;
+    }
+
     env->tlb_flush_addr = -1;
     env->tlb_flush_mask = 0;
     tlb_flush_count++;
@@ -2058,6 +2445,11 @@ void tlb_flush_page(CPUState *env, target_ulong addr)
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++)
         tlb_flush_entry(&env->tlb_table[mmu_idx][i], addr);
 
+    i = (addr >> TARGET_PAGE_BITS) & (CPU_CODE_PAGE_SIZE - 1);
+    if (env->code_page_cache[i].vaddr == addr) {
+        env->code_page_cache[i].vaddr = -1;
+    }
+
     tlb_flush_jmp_cache(env, addr);
 }
 
@@ -2306,6 +2698,7 @@ void tlb_set_page(CPUState *env, target_ulong vaddr,
     target_phys_addr_t iotlb;
     TLM_RAMBlock *tlm_rb = NULL;
 
+    tlb_fill_count++;
     assert(size >= TARGET_PAGE_SIZE);
     if (size != TARGET_PAGE_SIZE) {
         tlb_add_large_page(env, vaddr, size);
@@ -2924,6 +3317,81 @@ static void *file_ram_alloc(RAMBlock *block,
     block->fd = fd;
     return area;
 }
+
+#define RAM_HUGEPAGE_ALIGN  (2 * 1024 * 1024)
+#define QEMU_MPOL_BIND      2
+
+/* Allocate anonymous guest RAM following the -machine mem-* policies.
+   Returns NULL when no policy is set.  */
+static void *anon_ram_alloc(RAMBlock *block, ram_addr_t size)
+{
+    size_t align = mem_hugepage ? RAM_HUGEPAGE_ALIGN : getpagesize();
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    uint8_t *area, *host;
+    unsigned long nodemask;
+    ram_addr_t i;
+    int fd = -1;
+
+    if (!mem_hugepage && !mem_prealloc && !mem_shared && mem_host_node < 0) {
+        return NULL;
+    }
+
+    if (mem_shared) {
+#ifdef __NR_memfd_create
+        fd = syscall(__NR_memfd_create, block->idstr, 0);
+        if (fd >= 0 && ftruncate(fd, size) < 0) {
+            close(fd);
+            fd = -1;
+        }
+#endif
+        flags = fd >= 0 ? MAP_SHARED : MAP_SHARED | MAP_ANONYMOUS;
+    }
+
+    /* reserve enough address space to place the block on an aligned
+       boundary, then map it there */
+    area = mmap(NULL, size + align, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (area == MAP_FAILED) {
+        goto fail;
+    }
+    host = (uint8_t *)(((uintptr_t)area + align - 1) & ~(uintptr_t)(align - 1));
+    if (host > area) {
+        munmap(area, host - area);
+    }
+    munmap(host + size, area + size + align - (host + size));
+    if (mmap(host, size, PROT_READ | PROT_WRITE, flags | MAP_FIXED,
+             fd, 0) == MAP_FAILED) {
+        munmap(host, size);
+        goto fail;
+    }
+
+    if (mem_hugepage && qemu_madvise(host, size, QEMU_MADV_HUGEPAGE) < 0) {
+        perror("anon_ram_alloc: madvise(MADV_HUGEPAGE)");
+    }
+    if (mem_host_node >= 0) {
+        nodemask = 1UL << mem_host_node;
+        if (syscall(__NR_mbind, host, size, QEMU_MPOL_BIND, &nodemask,
+                    sizeof(nodemask) * 8, 0) < 0) {
+            perror("anon_ram_alloc: mbind");
+        }
+    }
+    if (mem_prealloc) {
+        for (i = 0; i < size; i += getpagesize()) {
+            host[i] = 0;
+        }
+    }
+
+    block->fd = fd;
+    block->flags |= RAM_MMAP_MASK;
+    return host;
+
+fail:
+    perror("anon_ram_alloc: can't mmap RAM pages");
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
 #endif
 
 static ram_addr_t find_ram_offset(ram_addr_t size)
@@ -2971,6 +3439,9 @@ ram_addr_t qemu_ram_alloc_from_ptr_2(DeviceState *dev, const char *name,
 
     size = TARGET_PAGE_ALIGN(size);
     new_block = g_malloc0(sizeof(*new_block));
+#if defined(__linux__) && !defined(TARGET_S390X)
+    new_block->fd = -1;
+#endif
 
     if (dev && dev->parent_bus && dev->parent_bus->info->get_dev_path) {
         char *id = dev->parent_bus->info->get_dev_path(dev);
@@ -3026,6 +3497,10 @@ ram_addr_t qemu_ram_alloc_from_ptr_2(DeviceState *dev, const char *name,
             if (xen_enabled()) {
                 xen_ram_alloc(new_block->offset, size);
             } else {
+#if defined(__linux__) && !defined(TARGET_S390X)
+                new_block->host = anon_ram_alloc(new_block, size);
+                if (!new_block->host)
+#endif
                 new_block->host = qemu_vmalloc(size);
             }
 #endif
@@ -3081,7 +3556,7 @@ void qemu_ram_free(ram_addr_t addr)
                 ;
             } else if (mem_path) {
 #if defined (__linux__) && !defined(TARGET_S390X)
-                if (block->fd) {
+                if (block->fd >= 0) {
                     munmap(block->host, block->length);
                     close(block->fd);
                 } else {
@@ -3096,6 +3571,13 @@ void qemu_ram_free(ram_addr_t addr)
 #else
                 if (xen_enabled()) {
                     xen_invalidate_map_cache_entry(block->host);
+                } else if (block->flags & RAM_MMAP_MASK) {
+                    munmap(block->host, block->length);
+#if defined(__linux__) && !defined(TARGET_S390X)
+                    if (block->fd >= 0) {
+                        close(block->fd);
+                    }
+#endif
                 } else {
                     qemu_vfree(block->host);
                 }
@@ -3127,7 +3609,7 @@ void qemu_ram_remap(ram_addr_t addr, ram_addr_t length)
                 munmap(vaddr, length);
                 if (mem_path) {
 #if defined(__linux__) && !defined(TARGET_S390X)
-                    if (block->fd) {
+                    if (block->fd >= 0) {
 #ifdef MAP_POPULATE
                         flags |= mem_prealloc ? MAP_POPULATE | MAP_SHARED :
                             MAP_PRIVATE;
@@ -3150,9 +3632,21 @@ void qemu_ram_remap(ram_addr_t addr, ram_addr_t length)
                     area = mmap(vaddr, length, PROT_EXEC|PROT_READ|PROT_WRITE,
                                 flags, -1, 0);
 #else
-                    flags |= MAP_PRIVATE | MAP_ANONYMOUS;
-                    area = mmap(vaddr, length, PROT_READ | PROT_WRITE,
-                                flags, -1, 0);
+                    if (!(block->flags & RAM_MMAP_MASK) || !mem_shared) {
+                        flags |= MAP_PRIVATE | MAP_ANONYMOUS;
+                        area = mmap(vaddr, length, PROT_READ | PROT_WRITE,
+                                    flags, -1, 0);
+#if defined(__linux__) && !defined(TARGET_S390X)
+                    } else if (block->fd >= 0) {
+                        flags |= MAP_SHARED;
+                        area = mmap(vaddr, length, PROT_READ | PROT_WRITE,
+                                    flags, block->fd, offset);
+#endif
+                    } else {
+                        flags |= MAP_SHARED | MAP_ANONYMOUS;
+                        area = mmap(vaddr, length, PROT_READ | PROT_WRITE,
+                                    flags, -1, 0);
+                    }
 #endif
                 }
                 if (area != vaddr) {
@@ -4922,6 +5416,51 @@ int cpu_memory_rw_debug(CPUState *env, target_ulong addr,
 }
 #endif
 
+/* Let an I/O access in the middle of a TB see the exact instruction
+   count, without recompiling the TB to end on the access like
+   cpu_io_recompile does. The instructions following the access in the
+   TB, already accounted for at TB entry, are credited back to the
+   budget until cpu_io_icount_end is called with the returned credit.
+   The credit is also kept in env so that cpu_exec can take it back if
+   the access longjmps out of the TB.  */
+int cpu_io_icount_begin(CPUState *env, void *retaddr)
+{
+    unsigned long pc = (unsigned long)retaddr;
+    unsigned int h = (pc ^ (pc >> 8)) & (IO_ICOUNT_CACHE_SIZE - 1);
+    TranslationBlock *tb;
+    int left, n;
+
+    if (io_icount_cache[h].pc == pc) {
+        left = io_icount_cache[h].left;
+    } else {
+        tb = tb_find_pc(pc);
+        if (!tb) {
+            cpu_abort(env, "cpu_io_icount_begin: could not find TB for pc=%p",
+                      retaddr);
+        }
+        n = cpu_restore_icount(tb, env, pc);
+        if (n < 0) {
+            /* Should not happen, take the slow road.  */
+            cpu_io_recompile(env, retaddr);
+        }
+        left = tb->icount - n - 1;
+        io_icount_cache[h].pc = pc;
+        io_icount_cache[h].left = left;
+    }
+
+    env->icount_decr.u16.low += left;
+    env->can_do_io = 1;
+    env->io_icount_credit = left;
+    return left;
+}
+
+void cpu_io_icount_end(CPUState *env, int credit)
+{
+    env->icount_decr.u16.low -= credit;
+    env->can_do_io = 0;
+    env->io_icount_credit = -1;
+}
+
 /* in deterministic execution mode, instructions doing device I/Os
    must be at the end of the TB */
 void cpu_io_recompile(CPUState *env, void *retaddr)
@@ -0,0 +1,212 @@
+/*
+ * Fork server: clone a booted instance copy-on-write
+ *
+ * The instance is stopped at a quiesced point and every connection to
+ * the server socket gets a child process of its own.  The child shares
+ * guest RAM and translated code with its parent through fork(), rebuilds
+ * the host state that fork() does not carry over, and is then driven
+ * through a QMP monitor on the connection.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu-common.h"
+#include "qemu-char.h"
+#include "qemu-timer.h"
+#include "qemu-aio.h"
+#include "qemu-log.h"
+#include "qemu_socket.h"
+#include "qerror.h"
+#include "monitor.h"
+#include "sysemu.h"
+#include "cpus.h"
+#include "block.h"
+#include "kvm.h"
+#include "cpu.h"
+#include "tlm.h"
+#include "fork-server.h"
+
+#ifndef _WIN32
+#include "block/raw-posix-aio.h"
+#endif
+
+#ifdef CONFIG_LINUX
+#include <link.h>
+#endif
+
+//#define DEBUG_FORK_SERVER
+
+#ifdef DEBUG_FORK_SERVER
+#define DPRINTF(fmt, ...) \
+    do { printf("fork-server: " fmt, ## __VA_ARGS__); } while (0)
+#else
+#define DPRINTF(fmt, ...) \
+    do { } while (0)
+#endif
+
+#if !defined(_WIN32) && !defined(CONFIG_IOTHREAD)
+static int fork_server_fd = -1;
+
+/* Children of one instance must not write to a shared image.  */
+static void fork_server_check_bdrv(void *opaque, BlockDriverState *bs)
+{
+    const char **writable = opaque;
+
+    if (!*writable && bdrv_is_inserted(bs) && !bdrv_is_read_only(bs)) {
+        *writable = bdrv_get_device_name(bs);
+    }
+}
+
+#ifdef CONFIG_LINUX
+/* tlmu_load() dlopens a private copy of the library under .tlmu/ for
+   every instance.  */
+static int fork_server_count_instance(struct dl_phdr_info *info, size_t size,
+                                      void *opaque)
+{
+    int *n = opaque;
+
+    if (info->dlpi_name && strstr(info->dlpi_name, ".tlmu/")) {
+        (*n)++;
+    }
+    return 0;
+}
+#endif
+
+/* The other instances of a TLMu process would be cloned along, without
+   the threads, timers and notifiers that only this one re-creates.  */
+static int fork_server_instances(void)
+{
+    int n = 0;
+
+#ifdef CONFIG_LINUX
+    dl_iterate_phdr(fork_server_count_instance, &n);
+#endif
+    return n;
+}
+
+/* Stop at a point where nothing is in flight: posted TLM writes are
+   handed over and SystemC is synced, then block requests are drained.  */
+static void fork_server_quiesce(void)
+{
+    vm_stop(VMSTOP_USER);
+    tlm_flush_posted_writes();
+    if (tlm_sync) {
+        tlm_sync(tlm_opaque, qemu_get_clock_ns(vm_clock));
+    }
+    qemu_aio_flush();
+    bdrv_flush_all();
+}
+
+static void fork_server_child(int csock)
+{
+    CharDriverState *chr;
+
+    /* Everything that is read from so far belongs to the parent, and so
+       do the terminals, sockets and files the chardevs write to.  */
+    qemu_iohandler_clear();
+    close(fork_server_fd);
+    fork_server_fd = -1;
+    qemu_chr_fork_child();
+    monitor_fork_child();
+
+    if (qemu_init_main_loop_child() < 0) {
+        fprintf(stderr, "fork-server: failed to set up the main loop\n");
+        _exit(1);
+    }
+    if (paio_fork_child() < 0) {
+        _exit(1);
+    }
+    if (reinit_timer_alarm() < 0) {
+        fprintf(stderr, "fork-server: could not start the alarm timer\n");
+        _exit(1);
+    }
+    cpu_set_log_fork_child();
+
+    /* A clone lives as long as the connection that asked for it.  */
+    chr = qemu_chr_open_socket_fd(csock, 1);
+    monitor_init(chr, MONITOR_USE_CONTROL | MONITOR_QUIT_ON_CLOSE);
+    DPRINTF("child %d serving on fd %d\n", (int)getpid(), csock);
+}
+
+static void fork_server_accept(void *opaque)
+{
+    int csock;
+    pid_t pid;
+
+    csock = qemu_accept(fork_server_fd, NULL, NULL);
+    if (csock < 0) {
+        return;
+    }
+
+    /* The parent may have been continued from its own monitor.  */
+    if (vm_running) {
+        fork_server_quiesce();
+    }
+
+    /* Nothing buffered by the parent should be written twice.  */
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid == 0) {
+        fork_server_child(csock);
+        return;
+    }
+    if (pid < 0) {
+        perror("fork-server: fork");
+    } else {
+        DPRINTF("forked child %d\n", (int)pid);
+        qemu_add_child_watch(pid);
+    }
+    close(csock);
+}
+
+int do_fork_server(Monitor *mon, const QDict *qdict, QObject **ret_data)
+{
+    const char *path = qdict_get_str(qdict, "path");
+    const char *writable = NULL;
+
+    if (fork_server_fd != -1) {
+        qerror_report(QERR_DEVICE_IN_USE, "fork-server");
+        return -1;
+    }
+    /* vCPU state lives in the kernel and cannot be forked.  */
+    if (kvm_enabled()) {
+        qerror_report(QERR_UNSUPPORTED);
+        return -1;
+    }
+    if (fork_server_instances() > 1) {
+        qerror_report(QERR_UNSUPPORTED);
+        return -1;
+    }
+    /* A shared mapping would make the clones write to each other.  */
+    if (mem_shared) {
+        qerror_report(QERR_INVALID_PARAMETER_VALUE, "mem-shared", "off");
+        return -1;
+    }
+    bdrv_iterate(fork_server_check_bdrv, &writable);
+    if (writable) {
+        qerror_report(QERR_DEVICE_IN_USE, writable);
+        return -1;
+    }
+
+    fork_server_quiesce();
+
+    fork_server_fd = unix_listen(path, NULL, 0);
+    if (fork_server_fd < 0) {
+        qerror_report(QERR_UNDEFINED_ERROR);
+        return -1;
+    }
+    qemu_set_fd_handler2(fork_server_fd, NULL, fork_server_accept, NULL,
+                         NULL);
+    return 0;
+}
+#else
+/* The other threads, and the Win32 process model, do not survive it.  */
+int do_fork_server(Monitor *mon, const QDict *qdict, QObject **ret_data)
+{
+    qerror_report(QERR_UNSUPPORTED);
+    return -1;
+}
+#endif
@@ -0,0 +1,16 @@
+/*
+ * Fork server: clone a booted instance copy-on-write
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_FORK_SERVER_H
+#define QEMU_FORK_SERVER_H
+
+#include "qemu-common.h"
+#include "qdict.h"
+
+int do_fork_server(Monitor *mon, const QDict *qdict, QObject **ret_data);
+
+#endif
@@ -13,22 +13,33 @@ static inline void gen_icount_start(void)
         return;
 
     icount_label = gen_new_label();
-    count = tcg_temp_local_new_i32();
+    /* Commit the new budget before the branch, so that COUNT is an
+       ordinary temp and is not spilled across it.  The exit path puts
+       the budget back for cpu_exec().  */
+    count = tcg_temp_new_i32();
     tcg_gen_ld_i32(count, cpu_env, offsetof(CPUState, icount_decr.u32));
     /* This is a horrid hack to allow fixing up the value later.  */
     icount_arg = gen_opparam_ptr + 1;
     tcg_gen_subi_i32(count, count, 0xdeadbeef);
-
-    tcg_gen_brcondi_i32(TCG_COND_LT, count, 0, icount_label);
     tcg_gen_st16_i32(count, cpu_env, offsetof(CPUState, icount_decr.u16.low));
+    tcg_gen_brcondi_i32(TCG_COND_LT, count, 0, icount_label);
     tcg_temp_free_i32(count);
 }
 
 static void gen_icount_end(TranslationBlock *tb, int num_insns)
 {
+    TCGv_i32 count;
+
     if (use_icount) {
         *icount_arg = num_insns;
         gen_set_label(icount_label);
+        count = tcg_temp_new_i32();
+        tcg_gen_ld16u_i32(count, cpu_env,
+                          offsetof(CPUState, icount_decr.u16.low));
+        tcg_gen_addi_i32(count, count, num_insns);
+        tcg_gen_st16_i32(count, cpu_env,
+                         offsetof(CPUState, icount_decr.u16.low));
+        tcg_temp_free_i32(count);
         tcg_gen_exit_tb((tcg_target_long)tb + 2);
     }
 }
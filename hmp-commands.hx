@@ -819,6 +819,29 @@ STEXI
 @item migrate_set_downtime @var{second}
 @findex migrate_set_downtime
 Set maximum tolerated downtime (in seconds) for migration.
+ETEXI
+
+    {
+        .name       = "fork_server",
+        .args_type  = "path:s",
+        .params     = "path",
+        .help       = "stop the VM and fork a clone of it per connection to 'path'",
+        .user_print = monitor_user_noop,
+        .mhandler.cmd_new = do_fork_server,
+    },
+
+STEXI
+@item fork_server @var{path}
+@findex fork_server
+Stop the VM at a quiesced point and listen on the unix socket @var{path}.
+Each connection forks a stopped copy of the VM that shares guest RAM with
+this instance copy-on-write and is controlled through QMP on the
+connection; it exits when the connection is closed.  Block devices must be
+read-only, and KVM, @code{mem-shared} RAM and processes with more than one
+TLMu instance are refused.  Clones do not receive input from the devices they
+inherit, so tap networking and 9p do not work in them.  Their character
+devices are turned into null devices and they do not see this instance's
+monitors, so their output and events only go to their own connection.
 ETEXI
 
     {
@@ -1293,6 +1316,8 @@ show the character devices
 show the block devices
 @item info blockstats
 show block device statistics
+@item info stats
+show performance counters and their change since the last query
 @item info registers
 show the cpu registers
 @item info cpus
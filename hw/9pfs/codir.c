@@ -81,6 +81,7 @@ int v9fs_co_mkdir(V9fsState *s, char *name, mode_t mode, uid_t uid, gid_t gid)
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
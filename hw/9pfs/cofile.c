@@ -15,12 +15,77 @@
 #include "fsdev/qemu-fsdev.h"
 #include "qemu-thread.h"
 #include "qemu-coroutine.h"
+#include "qemu-timer.h"
 #include "virtio-9p-coth.h"
 
+/*
+ * Successful lstat results are kept for a short while so that the
+ * walk/getattr storms issued by guests do not each cost a round trip
+ * to the worker threads.  Any request that can change file attributes
+ * drops the whole cache.
+ */
+#define V9FS_ATTR_CACHE_MS  100
+#define V9FS_ATTR_CACHE_MAX 1024
+
+typedef struct V9fsAttrCacheEntry {
+    struct stat stbuf;
+    int64_t expire;
+} V9fsAttrCacheEntry;
+
+void v9fs_attr_cache_invalidate(V9fsState *s)
+{
+    s->attr_gen++;
+    if (s->attr_cache) {
+        g_hash_table_remove_all(s->attr_cache);
+    }
+}
+
+static int v9fs_attr_cache_lookup(V9fsState *s, const char *path,
+                                  struct stat *stbuf)
+{
+    V9fsAttrCacheEntry *e;
+
+    if (!s->attr_cache) {
+        return 0;
+    }
+    e = g_hash_table_lookup(s->attr_cache, path);
+    if (!e) {
+        return 0;
+    }
+    if (qemu_get_clock_ms(rt_clock) >= e->expire) {
+        g_hash_table_remove(s->attr_cache, path);
+        return 0;
+    }
+    *stbuf = e->stbuf;
+    return 1;
+}
+
+static void v9fs_attr_cache_insert(V9fsState *s, const char *path,
+                                   const struct stat *stbuf)
+{
+    V9fsAttrCacheEntry *e;
+
+    if (!s->attr_cache) {
+        s->attr_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              g_free, g_free);
+    } else if (g_hash_table_size(s->attr_cache) >= V9FS_ATTR_CACHE_MAX) {
+        g_hash_table_remove_all(s->attr_cache);
+    }
+    e = g_malloc(sizeof(*e));
+    e->stbuf = *stbuf;
+    e->expire = qemu_get_clock_ms(rt_clock) + V9FS_ATTR_CACHE_MS;
+    g_hash_table_insert(s->attr_cache, g_strdup(path), e);
+}
+
 int v9fs_co_lstat(V9fsState *s, V9fsString *path, struct stat *stbuf)
 {
     int err;
+    unsigned int gen;
 
+    if (v9fs_attr_cache_lookup(s, path->data, stbuf)) {
+        return 0;
+    }
+    gen = s->attr_gen;
     v9fs_co_run_in_worker(
         {
             err = s->ops->lstat(&s->ctx, path->data, stbuf);
@@ -28,6 +93,10 @@ int v9fs_co_lstat(V9fsState *s, V9fsString *path, struct stat *stbuf)
                 err = -errno;
             }
         });
+    /* Don't cache a result that raced with a modifying request */
+    if (err == 0 && gen == s->attr_gen) {
+        v9fs_attr_cache_insert(s, path->data, stbuf);
+    }
     return err;
 }
 
@@ -58,6 +127,9 @@ int v9fs_co_open(V9fsState *s, V9fsFidState *fidp, int flags)
                 err = 0;
             }
         });
+    if (flags & O_TRUNC) {
+        v9fs_attr_cache_invalidate(s);
+    }
     return err;
 }
 
@@ -79,6 +151,7 @@ int v9fs_co_open2(V9fsState *s, V9fsFidState *fidp, char *fullname, gid_t gid,
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
@@ -125,6 +198,7 @@ int v9fs_co_link(V9fsState *s, V9fsString *oldpath, V9fsString *newpath)
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
@@ -142,6 +216,7 @@ int v9fs_co_pwritev(V9fsState *s, V9fsFidState *fidp,
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
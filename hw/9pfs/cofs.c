@@ -71,6 +71,7 @@ int v9fs_co_chmod(V9fsState *s, V9fsString *path, mode_t mode)
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
@@ -86,6 +87,7 @@ int v9fs_co_utimensat(V9fsState *s, V9fsString *path,
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
@@ -104,6 +106,7 @@ int v9fs_co_chown(V9fsState *s, V9fsString *path, uid_t uid, gid_t gid)
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
@@ -118,6 +121,7 @@ int v9fs_co_truncate(V9fsState *s, V9fsString *path, off_t size)
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
@@ -139,6 +143,7 @@ int v9fs_co_mknod(V9fsState *s, V9fsString *path, uid_t uid,
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
@@ -153,6 +158,7 @@ int v9fs_co_remove(V9fsState *s, V9fsString *path)
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
@@ -167,6 +173,7 @@ int v9fs_co_rename(V9fsState *s, V9fsString *oldpath, V9fsString *newpath)
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
@@ -187,5 +194,6 @@ int v9fs_co_symlink(V9fsState *s, V9fsFidState *fidp,
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
@@ -64,6 +64,7 @@ int v9fs_co_lsetxattr(V9fsState *s, V9fsString *path,
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
 
@@ -80,5 +81,6 @@ int v9fs_co_lremovexattr(V9fsState *s, V9fsString *path,
                 err = -errno;
             }
         });
+    v9fs_attr_cache_invalidate(s);
     return err;
 }
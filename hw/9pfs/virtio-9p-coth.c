@@ -21,21 +21,35 @@
 /* v9fs glib thread pool */
 static V9fsThPool v9fs_pool;
 
-void co_run_in_worker_bh(void *opaque)
+static void co_run_in_worker_bh(void *opaque)
 {
-    Coroutine *co = opaque;
-    g_thread_pool_push(v9fs_pool.pool, co, NULL);
+    Coroutine *co;
+
+    while ((co = g_queue_pop_head(v9fs_pool.pending)) != NULL) {
+        g_thread_pool_push(v9fs_pool.pool, co, NULL);
+    }
+}
+
+void co_run_in_worker_queue(Coroutine *co)
+{
+    g_queue_push_tail(v9fs_pool.pending, co);
+    qemu_bh_schedule(v9fs_pool.submit_bh);
 }
 
 static void v9fs_qemu_process_req_done(void *arg)
 {
-    char byte;
+    char buffer[512];
     ssize_t len;
     Coroutine *co;
 
+    /* Drain the notifier.  For eventfd, only 8 bytes will be read.  */
     do {
-        len = read(v9fs_pool.rfd, &byte, sizeof(byte));
-    } while (len == -1 &&  errno == EINTR);
+        len = read(v9fs_pool.rfd, buffer, sizeof(buffer));
+    } while ((len == -1 && errno == EINTR) || len == sizeof(buffer));
+
+    /* Completions queued from now on need a new wakeup.  */
+    __sync_lock_release(&v9fs_pool.notified);
+    __sync_synchronize();
 
     while ((co = g_async_queue_try_pop(v9fs_pool.completed)) != NULL) {
         qemu_coroutine_enter(co, NULL);
@@ -44,15 +58,21 @@ static void v9fs_qemu_process_req_done(void *arg)
 
 static void v9fs_thread_routine(gpointer data, gpointer user_data)
 {
+    /* Write 8 bytes to be compatible with eventfd.  */
+    static const uint64_t val = 1;
     ssize_t len;
-    char byte = 0;
     Coroutine *co = data;
 
     qemu_coroutine_enter(co, NULL);
 
     g_async_queue_push(v9fs_pool.completed, co);
+    /* Only the first completion since the last drain wakes up the
+       iothread, the others are picked up by the same wakeup.  */
+    if (__sync_lock_test_and_set(&v9fs_pool.notified, 1)) {
+        return;
+    }
     do {
-        len = write(v9fs_pool.wfd, &byte, sizeof(byte));
+        len = write(v9fs_pool.wfd, &val, sizeof(val));
     } while (len == -1 && errno == EINTR);
 }
 
@@ -71,7 +91,7 @@ int v9fs_init_worker_threads(void)
     if (!g_thread_supported()) {
         g_thread_init(NULL);
     }
-    if (qemu_pipe(notifier_fds) == -1) {
+    if (qemu_eventfd(notifier_fds) == -1) {
         ret = -1;
         goto err_out;
     }
@@ -89,6 +109,8 @@ int v9fs_init_worker_threads(void)
         ret = -1;
         goto err_out;
     }
+    p->pending = g_queue_new();
+    p->submit_bh = qemu_bh_new(co_run_in_worker_bh, NULL);
     p->rfd = notifier_fds[0];
     p->wfd = notifier_fds[1];
 
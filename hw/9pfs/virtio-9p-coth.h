@@ -25,6 +25,11 @@ typedef struct V9fsThPool {
     int wfd;
     GThreadPool *pool;
     GAsyncQueue *completed;
+    /* coroutines waiting for submit_bh to hand them to the pool */
+    GQueue *pending;
+    QEMUBH *submit_bh;
+    /* set while a completion wakeup is outstanding on wfd */
+    int notified;
 } V9fsThPool;
 
 /*
@@ -36,26 +41,26 @@ typedef struct V9fsThPool {
  *   3. Enter the coroutine in the worker thread.
  * we cannot swap step 1 and 2, because that would imply worker thread
  * can enter coroutine while step1 is still running
+ *
+ * A single bottom half is shared by all requests; it submits every
+ * coroutine queued since it last ran.
  */
 #define v9fs_co_run_in_worker(code_block)                               \
     do {                                                                \
-        QEMUBH *co_bh;                                                  \
-        co_bh = qemu_bh_new(co_run_in_worker_bh,                        \
-                            qemu_coroutine_self());                     \
-        qemu_bh_schedule(co_bh);                                        \
+        co_run_in_worker_queue(qemu_coroutine_self());                  \
         /*                                                              \
          * yeild in qemu thread and re-enter back                       \
          * in glib worker thread                                        \
          */                                                             \
         qemu_coroutine_yield();                                         \
-        qemu_bh_delete(co_bh);                                          \
         code_block;                                                     \
         /* re-enter back to qemu thread */                              \
         qemu_coroutine_yield();                                         \
     } while (0)
 
-extern void co_run_in_worker_bh(void *);
+extern void co_run_in_worker_queue(Coroutine *);
 extern int v9fs_init_worker_threads(void);
+extern void v9fs_attr_cache_invalidate(V9fsState *);
 extern int v9fs_co_readlink(V9fsState *, V9fsString *, V9fsString *);
 extern int v9fs_co_readdir_r(V9fsState *, V9fsFidState *,
                            struct dirent *, struct dirent **result);
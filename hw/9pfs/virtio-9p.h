@@ -220,6 +220,9 @@ typedef struct V9fsState
     size_t config_size;
     enum p9_proto_version proto_version;
     int32_t msize;
+    /* short-lived lstat cache, see cofile.c */
+    GHashTable *attr_cache;
+    unsigned int attr_gen;
 } V9fsState;
 
 typedef struct V9fsStatState {
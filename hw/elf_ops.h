@@ -255,14 +255,6 @@ static int glue(load_elf, SZ)(const char *name, int fd,
         ph = &phdr[i];
         if (ph->p_type == PT_LOAD && ph->p_memsz) {
             mem_size = ph->p_memsz;
-            /* XXX: avoid allocating */
-            data = g_malloc0(mem_size);
-            if (ph->p_filesz > 0) {
-                if (lseek(fd, ph->p_offset, SEEK_SET) < 0)
-                    goto fail;
-                if (read(fd, data, ph->p_filesz) != ph->p_filesz)
-                    goto fail;
-            }
             /* address_offset is hack for kernel images that are
                linked at the wrong physical address.  */
             if (translate_fn) {
@@ -272,7 +264,18 @@ static int glue(load_elf, SZ)(const char *name, int fd,
             }
 
             snprintf(label, sizeof(label), "phdr #%d: %s", i, name);
-            rom_add_blob_fixed(label, data, mem_size, addr);
+            if (ph->p_filesz > mem_size
+                || rom_add_file_mapped(label, name, fd, ph->p_offset,
+                                       ph->p_filesz, mem_size, addr) < 0) {
+                data = g_malloc0(mem_size);
+                if (ph->p_filesz > 0) {
+                    if (lseek(fd, ph->p_offset, SEEK_SET) < 0)
+                        goto fail;
+                    if (read(fd, data, ph->p_filesz) != ph->p_filesz)
+                        goto fail;
+                }
+                rom_add_blob_fixed(label, data, mem_size, addr);
+            }
 
             total_size += mem_size;
             if (addr < low)
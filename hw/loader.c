@@ -51,6 +51,9 @@
 #include "fw_cfg.h"
 
 #include <zlib.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 static int roms_loaded;
 
@@ -534,6 +537,14 @@ struct Rom {
 
     target_phys_addr_t addr;
     QTAILQ_ENTRY(Rom) next;
+
+    /* data points into a private file mapping, see rom_map_file */
+    void *map_base;
+    size_t map_len;
+    char *map_path;
+#ifndef _WIN32
+    struct stat map_st;
+#endif
 };
 
 static FWCfgState *fw_cfg;
@@ -557,6 +568,140 @@ static void rom_insert(Rom *rom)
     QTAILQ_INSERT_TAIL(&roms, rom, next);
 }
 
+/* Map @filesz bytes of @fd at @offset copy-on-write, followed by zeros
+   up to @memsz.  Images are only read into guest memory at reset, so
+   this saves reading them into a buffer and copying that around.
+   Instances that load the same file share the page cache pages.
+   Pages of a private mapping that were never written still follow the
+   file, so a reset is refused if @path changed meanwhile, see
+   rom_check_mappings.  */
+static void *rom_map_file(Rom *rom, const char *path, int fd, off_t offset,
+                          size_t filesz, size_t memsz)
+{
+#ifndef _WIN32
+    size_t pagesize = getpagesize();
+    size_t delta = offset & (pagesize - 1);
+    size_t end = delta + filesz;
+    struct stat st;
+    uint8_t *base;
+    char *real;
+
+    if (fstat(fd, &st) < 0
+        || (uint64_t)offset + filesz > (uint64_t)st.st_size) {
+        return NULL;
+    }
+    real = realpath(path, NULL);
+    if (!real) {
+        return NULL;
+    }
+    rom->map_len = (delta + memsz + pagesize - 1) & ~(pagesize - 1);
+    base = mmap(NULL, rom->map_len, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        free(real);
+        return NULL;
+    }
+    if (filesz && mmap(base, end, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_FIXED, fd,
+                       offset - delta) == MAP_FAILED) {
+        munmap(base, rom->map_len);
+        free(real);
+        return NULL;
+    }
+    /* the file mapping covers the rest of its last page too */
+    if (memsz > filesz && (end & (pagesize - 1))) {
+        memset(base + end, 0, MIN(pagesize - (end & (pagesize - 1)),
+                                  memsz - filesz));
+    }
+    rom->map_base = base;
+    rom->map_path = g_strdup(real);
+    rom->map_st = st;
+    free(real);
+    return base + delta;
+#else
+    return NULL;
+#endif
+}
+
+static void rom_free_data(Rom *rom)
+{
+#ifndef _WIN32
+    if (rom->map_base) {
+        munmap(rom->map_base, rom->map_len);
+        g_free(rom->map_path);
+        rom->map_path = NULL;
+        rom->map_base = NULL;
+        rom->data = NULL;
+        return;
+    }
+#endif
+    g_free(rom->data);
+    rom->data = NULL;
+}
+
+/* A firmware file rebuilt after it was loaded would show through the
+   untouched pages of the mapping, and one truncated would raise SIGBUS.
+   Rereading it is no fix either: the old offsets need not hold in a new
+   ELF, and patches made through rom_ptr would be lost.  */
+static int rom_mapping_changed(Rom *rom)
+{
+#ifndef _WIN32
+    struct stat st;
+
+    if (!rom->map_base) {
+        return 0;
+    }
+    if (stat(rom->map_path, &st) == 0
+        && st.st_dev == rom->map_st.st_dev
+        && st.st_ino == rom->map_st.st_ino
+        && st.st_size == rom->map_st.st_size
+        && st.st_mtime == rom->map_st.st_mtime
+#ifdef CONFIG_LINUX
+        && st.st_mtim.tv_nsec == rom->map_st.st_mtim.tv_nsec
+#endif
+        ) {
+        return 0;
+    }
+    fprintf(stderr, "rom: file %-20s: %s changed on disk since it was "
+            "loaded\n", rom->name, rom->map_path);
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+int rom_check_mappings(void)
+{
+    Rom *rom;
+    int ret = 0;
+
+    QTAILQ_FOREACH(rom, &roms, next) {
+        if (rom_mapping_changed(rom)) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+int rom_add_file_mapped(const char *name, const char *path, int fd,
+                        off_t offset, size_t filesz, size_t memsz,
+                        target_phys_addr_t addr)
+{
+    Rom *rom;
+
+    rom = g_malloc0(sizeof(*rom));
+    rom->data = rom_map_file(rom, path, fd, offset, filesz, memsz);
+    if (!rom->data) {
+        g_free(rom);
+        return -1;
+    }
+    rom->name    = g_strdup(name);
+    rom->addr    = addr;
+    rom->romsize = memsz;
+    rom_insert(rom);
+    return 0;
+}
+
 int rom_add_file(const char *file, const char *fw_dir,
                  target_phys_addr_t addr, int32_t bootindex)
 {
@@ -584,13 +729,21 @@ int rom_add_file(const char *file, const char *fw_dir,
     }
     rom->addr    = addr;
     rom->romsize = lseek(fd, 0, SEEK_END);
-    rom->data    = g_malloc0(rom->romsize);
-    lseek(fd, 0, SEEK_SET);
-    rc = read(fd, rom->data, rom->romsize);
-    if (rc != rom->romsize) {
-        fprintf(stderr, "rom: file %-20s: read error: rc=%d (expected %zd)\n",
-                rom->name, rc, rom->romsize);
-        goto err;
+    /* fw_cfg keeps pointing at the data, it must not follow the file */
+    if (!rom->fw_file) {
+        rom->data = rom_map_file(rom, rom->path, fd, 0, rom->romsize,
+                                 rom->romsize);
+    }
+    if (!rom->data) {
+        rom->data = g_malloc0(rom->romsize);
+        lseek(fd, 0, SEEK_SET);
+        rc = read(fd, rom->data, rom->romsize);
+        if (rc != rom->romsize) {
+            fprintf(stderr,
+                    "rom: file %-20s: read error: rc=%d (expected %zd)\n",
+                    rom->name, rc, rom->romsize);
+            goto err;
+        }
     }
     close(fd);
     rom_insert(rom);
@@ -618,7 +771,7 @@ int rom_add_file(const char *file, const char *fw_dir,
 err:
     if (fd != -1)
         close(fd);
-    g_free(rom->data);
+    rom_free_data(rom);
     g_free(rom->path);
     g_free(rom->name);
     g_free(rom);
@@ -658,14 +811,14 @@ static void rom_reset(void *unused)
         if (rom->fw_file) {
             continue;
         }
-        if (rom->data == NULL) {
+        /* the main loop refuses such resets; other callers get no image */
+        if (rom->data == NULL || rom_mapping_changed(rom)) {
             continue;
         }
         cpu_physical_memory_write_rom(rom->addr, rom->data, rom->romsize);
         if (rom->isrom) {
             /* rom needs to be written only once */
-            g_free(rom->data);
-            rom->data = NULL;
+            rom_free_data(rom);
         }
     }
 }
@@ -25,7 +25,11 @@ int rom_add_file(const char *file, const char *fw_dir,
                  target_phys_addr_t addr, int32_t bootindex);
 int rom_add_blob(const char *name, const void *blob, size_t len,
                  target_phys_addr_t addr);
+int rom_add_file_mapped(const char *name, const char *path, int fd,
+                        off_t offset, size_t filesz, size_t memsz,
+                        target_phys_addr_t addr);
 int rom_load_all(void);
+int rom_check_mappings(void);
 void rom_set_fw(void *f);
 int rom_copy(uint8_t *dest, target_phys_addr_t addr, size_t size);
 void *rom_ptr(target_phys_addr_t addr);
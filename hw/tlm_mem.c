@@ -28,8 +28,10 @@
 #include "qemu-timer.h"
 #include "qemu-log.h"
 #include "qdev-addr.h"
+#include "qemu-stats.h"
 
 #include "gdbstub.h"
+#include "bitmap.h"
 #include "tlm.h"
 
 #define D(x)
@@ -72,6 +74,47 @@ struct TLMRegisterRamEntry {
 static struct TLMRegisterRamEntry *tlm_register_ram_entries = NULL;
 struct TLMMemory *main_tlmdev = NULL;
 
+/* IO indexes of the TLM bridges and of the RAMs among them. Looked up on
+   every IO access.  */
+static DECLARE_BITMAP(tlm_iodevs, IO_MEM_NB_ENTRIES);
+static DECLARE_BITMAP(tlm_ram_iodevs, IO_MEM_NB_ENTRIES);
+
+/* Bus areas with special attributes, see tlm_map_region.  */
+struct TLMRegion {
+    uint64_t base;
+    uint64_t size;
+    int attrs;
+
+    /* Shadow copy for TLMU_REGION_READ_CACHE areas.  */
+    uint8_t *shadow;
+    unsigned long *shadow_valid;
+
+    struct TLMRegion *next;
+};
+
+static struct TLMRegion *tlm_regions = NULL;
+/* Last region hit, accesses tend to come in bursts.  */
+static struct TLMRegion *tlm_last_region = NULL;
+
+#define TLM_MAX_POSTED_WRITES 32
+static struct tlmu_bus_req tlm_posted_writes[TLM_MAX_POSTED_WRITES];
+static int tlm_nr_posted_writes;
+
+/* Number of posted writes not yet acknowledged by the main emulator.  */
+static unsigned int tlm_nb_pending;
+
+/* Bridge traffic, reported through query-stats.  */
+static struct {
+    uint64_t bus_reads;
+    uint64_t bus_writes;
+    uint64_t dmi_reads;
+    uint64_t dmi_writes;
+    uint64_t shadow_hits;
+    uint64_t posted_writes;
+    uint64_t batches;
+    uint64_t nb_writes;
+} tlm_stats;
+
 void notdirty_mem_wr(target_phys_addr_t ram_addr, int len);
 
 static void tlm_write_irq(struct tlmu_irq *qirq)
@@ -116,6 +159,120 @@ int tlm_get_dmi_ptr(struct tlmu_dmi *dmi)
     return dmi->ptr != NULL;
 }
 
+static inline int tlm_region_hit(struct TLMRegion *r, uint64_t addr, int len)
+{
+    return addr >= r->base && addr + len - r->base <= r->size;
+}
+
+static struct TLMRegion *tlm_find_region(uint64_t addr, int len)
+{
+    struct TLMRegion *r;
+
+    if (tlm_last_region && tlm_region_hit(tlm_last_region, addr, len)) {
+        return tlm_last_region;
+    }
+
+    r = tlm_regions;
+    while (r) {
+        if (tlm_region_hit(r, addr, len)) {
+            tlm_last_region = r;
+            return r;
+        }
+        r = r->next;
+    }
+    return NULL;
+}
+
+static int tlm_shadow_read(struct TLMRegion *r, uint64_t addr,
+                           uint32_t *value, int len)
+{
+    uint64_t offset = addr - r->base;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        if (!test_bit(offset + i, r->shadow_valid)) {
+            return 0;
+        }
+    }
+    memcpy(value, r->shadow + offset, len);
+    return 1;
+}
+
+static void tlm_shadow_fill(struct TLMRegion *r, uint64_t addr,
+                            uint32_t value, int len)
+{
+    uint64_t offset = addr - r->base;
+    int i;
+
+    memcpy(r->shadow + offset, &value, len);
+    for (i = 0; i < len; i++) {
+        set_bit(offset + i, r->shadow_valid);
+    }
+}
+
+static void tlm_shadow_drop(struct TLMRegion *r, uint64_t addr, int len)
+{
+    uint64_t offset = addr - r->base;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        clear_bit(offset + i, r->shadow_valid);
+    }
+}
+
+/* Drop the shadow copies of every cached region overlapping the range.  */
+static void tlm_invalidate_shadows(uint64_t start, uint64_t end)
+{
+    struct TLMRegion *r;
+
+    r = tlm_regions;
+    while (r) {
+        if (r->shadow && start < r->base + r->size && end > r->base) {
+            bitmap_zero(r->shadow_valid, r->size);
+        }
+        r = r->next;
+    }
+}
+
+void tlm_flush_posted_writes(void)
+{
+    struct tlmu_bus_req req[TLM_MAX_POSTED_WRITES];
+    int nr = tlm_nr_posted_writes;
+
+    if (!nr) {
+        return;
+    }
+
+    /* The main emulator may access us while handling the batch, work on
+       a copy so that new writes can be posted meanwhile.  */
+    memcpy(req, tlm_posted_writes, nr * sizeof req[0]);
+    tlm_nr_posted_writes = 0;
+    tlm_stats.batches++;
+
+    if (tlm_bus_access_batch_cb(tlm_opaque, req, nr)) {
+        if (cpu_single_env && gdbserver_has_client()) {
+            cpu_interrupt(cpu_single_env, CPU_INTERRUPT_DEBUG);
+        }
+    }
+}
+
+static void tlm_post_write(int64_t clk, uint64_t addr, uint32_t value, int len)
+{
+    struct tlmu_bus_req *req;
+
+    if (tlm_nr_posted_writes == TLM_MAX_POSTED_WRITES) {
+        tlm_flush_posted_writes();
+    }
+
+    req = &tlm_posted_writes[tlm_nr_posted_writes++];
+    tlm_stats.posted_writes++;
+    req->clk = clk;
+    req->addr = addr;
+    req->data = 0;
+    memcpy(&req->data, &value, len);
+    req->len = len;
+}
+
 static inline
 int dmi_check_flags(struct TLMMemory *s, int flags) {
 	return (s->dmi.prot & flags) == flags;
@@ -156,6 +313,9 @@ static void tlm_invalidate_dmi(struct tlmu_dmi *dmi)
 
     /* Also check the main dev.  */
     tlm_check_invalidate_dmi(main_tlmdev, start, end);
+
+    /* The contents may have changed.  */
+    tlm_invalidate_shadows(start, end);
 }
 
 static void tlm_try_dmi(struct TLMMemory *s, uint64_t addr, int len)
@@ -191,31 +351,52 @@ uint32_t tlm_read(struct TLMMemory *s, target_phys_addr_t addr, int len)
 {
     uint32_t r = 0;
     uint64_t eaddr = s->base_addr + addr;
+    struct TLMRegion *region = NULL;
     int64_t clk;
     int dmi_supported;
 
 //    qemu_log("%s: addr=%lx,%lx.%lx len=%d\n", __func__, s->base_addr, eaddr, (unsigned long) addr, len);
 
+    if (tlm_regions) {
+        region = tlm_find_region(eaddr, len);
+    }
+
     if (dmi_is_allowed(s, TLMU_DMI_PROT_READ, eaddr, len)) {
         int offset;
         char *p = s->dmi.ptr;
 
         offset = eaddr - s->dmi.base;
         p += offset;
+        /* The read may depend on earlier posted writes, even in an
+           idempotent region.  */
+        tlm_flush_posted_writes();
         memcpy(&r, p, len);
+        tlm_stats.dmi_reads++;
         qemu_icount += s->dmi.read_latency * len;
-        if (!s->is_ram) {
+        if (!s->is_ram
+            && !(region && (region->attrs & TLMU_REGION_IDEMPOTENT))) {
             clk = qemu_get_clock_ns(vm_clock);
             tlm_sync(tlm_opaque, clk);
         }
         return r;
     }
 
+    if (region && region->shadow && tlm_shadow_read(region, eaddr, &r, len)) {
+        tlm_stats.shadow_hits++;
+        return r;
+    }
+
+    /* The read may depend on earlier posted writes.  */
+    tlm_flush_posted_writes();
     clk = qemu_get_clock_ns(vm_clock);
+    tlm_stats.bus_reads++;
     dmi_supported = tlm_bus_access_cb(tlm_opaque, clk, 0, eaddr, &r, len);
     if (dmi_supported && !s->dmi.prot) {
         tlm_try_dmi(s, eaddr, len);
     }
+    if (region && region->shadow) {
+        tlm_shadow_fill(region, eaddr, r, len);
+    }
 
     D(qemu_log("%s: addr=%lx r=%x len=%d\n", __func__, eaddr, r, len));
     return r;
@@ -225,12 +406,20 @@ static inline void
 tlm_write(struct TLMMemory *s, target_phys_addr_t addr, uint32_t value, int len)
 {
     uint64_t eaddr = s->base_addr + addr;
+    struct TLMRegion *region = NULL;
     int64_t clk;
     int dmi_supported;
 
     if (s->is_ram) {
         notdirty_mem_wr(eaddr, len);
     }
+
+    if (tlm_regions) {
+        region = tlm_find_region(eaddr, len);
+        if (region && region->shadow) {
+            tlm_shadow_drop(region, eaddr, len);
+        }
+    }
 //    qemu_log("%s: addr=%lx.%lx value=%x len=%d\n", __func__, eaddr, (unsigned long) addr, value, len);
 
     if (dmi_is_allowed(s, TLMU_DMI_PROT_WRITE, eaddr, len)) {
@@ -239,9 +428,13 @@ tlm_write(struct TLMMemory *s, target_phys_addr_t addr, uint32_t value, int len)
 
         offset = eaddr - s->dmi.base;
         p += offset;
+        /* Keep the writes in order.  */
+        tlm_flush_posted_writes();
         memcpy(p, &value, len);
+        tlm_stats.dmi_writes++;
         qemu_icount += s->dmi.write_latency * len;
-        if (!s->is_ram) {
+        if (!s->is_ram
+            && !(region && (region->attrs & TLMU_REGION_IDEMPOTENT))) {
             clk = qemu_get_clock_ns(vm_clock);
             tlm_sync(tlm_opaque, clk);
         }
@@ -249,6 +442,25 @@ tlm_write(struct TLMMemory *s, target_phys_addr_t addr, uint32_t value, int len)
     }
 
     clk = qemu_get_clock_ns(vm_clock);
+    if (region && (region->attrs & TLMU_REGION_WRITE_POSTING)
+        && tlm_bus_access_batch_cb && !s->is_ram) {
+        tlm_post_write(clk, eaddr, value, len);
+        return;
+    }
+
+    /* Keep the writes in order.  */
+    tlm_flush_posted_writes();
+    if (tlm_bus_access_nb_cb && !s->is_ram) {
+        /* Try to post the write.  */
+        if (tlm_bus_access_nb_cb(tlm_opaque, clk, 1, eaddr, &value, len)
+            == TLMU_NB_ACCEPTED) {
+            tlm_nb_pending++;
+            tlm_stats.nb_writes++;
+            return;
+        }
+    }
+
+    tlm_stats.bus_writes++;
     dmi_supported = tlm_bus_access_cb(tlm_opaque, clk, 1, eaddr, &value, len);
     if (dmi_supported && !s->dmi.prot) {
         tlm_try_dmi(s, eaddr, len);
@@ -312,6 +524,20 @@ static void update_irq(void *opaque)
     }
 }
 
+static void tlm_bus_complete(struct tlmu_bus_resp *resp)
+{
+    assert(tlm_nb_pending);
+    tlm_nb_pending--;
+
+    if (resp->error) {
+        D(qemu_log("%s: posted write to %" PRIx64 " failed\n",
+                   __func__, resp->addr));
+        if (cpu_single_env && gdbserver_has_client()) {
+            cpu_interrupt(cpu_single_env, CPU_INTERRUPT_DEBUG);
+        }
+    }
+}
+
 static void timer_hit(void *opaque)
 {
     struct TLMMemory *s = opaque;
@@ -350,6 +576,15 @@ void tlm_notify_event(enum tlmu_event ev, void *d)
               cpu_interrupt(cpu_single_env, CPU_INTERRUPT_DEBUG);
             }
             break;
+        case TLMU_TLM_EVENT_BUS_COMPLETE:
+            tlm_bus_complete(d);
+            break;
+        case TLMU_TLM_EVENT_INVALIDATE_CACHE:
+        {
+            struct tlmu_dmi *range = d;
+            tlm_invalidate_shadows(range->base, range->base + range->size);
+            break;
+        }
         default:
             break;
     }
@@ -384,6 +619,7 @@ static int tlm_memory_init(SysBusDevice *dev)
     io_tlm = cpu_register_io_memory(tlm_read_f, tlm_write_f, s,
                                     DEVICE_NATIVE_ENDIAN);
     sysbus_init_mmio(dev, s->size, io_tlm);
+    set_bit(io_tlm >> IO_MEM_SHIFT, tlm_iodevs);
 
     /* Register the main tlm dev.  Used for interrupts.  */
     main_tlmdev = s;
@@ -405,9 +641,23 @@ static SysBusDeviceInfo tlm_memory_info = {
     }
 };
 
+static void tlm_stats_snapshot(QDict *dict, void *opaque)
+{
+    qemu_stats_put(dict, NULL, "bus_reads", tlm_stats.bus_reads);
+    qemu_stats_put(dict, NULL, "bus_writes", tlm_stats.bus_writes);
+    qemu_stats_put(dict, NULL, "dmi_reads", tlm_stats.dmi_reads);
+    qemu_stats_put(dict, NULL, "dmi_writes", tlm_stats.dmi_writes);
+    qemu_stats_put(dict, NULL, "shadow_hits", tlm_stats.shadow_hits);
+    qemu_stats_put(dict, NULL, "posted_writes", tlm_stats.posted_writes);
+    qemu_stats_put(dict, NULL, "posted_batches", tlm_stats.batches);
+    qemu_stats_put(dict, NULL, "nb_writes", tlm_stats.nb_writes);
+    qemu_stats_put(dict, NULL, "nb_pending", tlm_nb_pending);
+}
+
 static void tlm_memory_register(void)
 {
     sysbus_register_withprop(&tlm_memory_info);
+    qemu_stats_register("tlm", tlm_stats_snapshot, NULL);
 }
 
 device_init(tlm_memory_register)
@@ -425,6 +675,8 @@ static void map_ram(struct TLMRegisterRamEntry *ram)
     ram->iodev = cpu_register_io_memory(tlm_read_f, tlm_write_f, ram->mem,
                                         DEVICE_NATIVE_ENDIAN);
     tlm_rb.iodev = ram->iodev;
+    set_bit(ram->iodev >> IO_MEM_SHIFT, tlm_iodevs);
+    set_bit(ram->iodev >> IO_MEM_SHIFT, tlm_ram_iodevs);
     p = qemu_ram_alloc_from_ptr_2(NULL, ram->name, ram->size,
                                   ((char *) 0) + ram->base, &tlm_rb);
     cpu_register_physical_memory(ram->base, ram->size,
@@ -433,16 +685,12 @@ static void map_ram(struct TLMRegisterRamEntry *ram)
 
 /* Used by exec-all when mapping in pages for code fetching.  */
 int tlm_iodev_is_ram(int iodev) {
-    struct TLMRegisterRamEntry *ram;
+    return test_bit(iodev, tlm_ram_iodevs);
+}
 
-    ram = tlm_register_ram_entries;
-    while (ram) {
-        if (iodev == (ram->iodev >> IO_MEM_SHIFT)) {
-            return 1;
-        }
-        ram = ram->next;
-    }
-    return 0;
+/* Used by the softmmu to avoid recompiling TBs on accesses to us.  */
+int tlm_iodev_is_tlm(int iodev) {
+    return test_bit(iodev, tlm_iodevs);
 }
 
 void tlm_map_ram(const char *name, uint64_t addr, uint64_t size, int rw)
@@ -465,6 +713,35 @@ void tlm_map_ram(const char *name, uint64_t addr, uint64_t size, int rw)
     tlm_register_ram_entries = ram;
 }
 
+void tlm_map_region(const char *name, uint64_t addr, uint64_t size, int attrs)
+{
+    struct TLMRegion *r;
+
+    /* Memory like areas and areas we need to fetch code from have to
+       be RAM mapped. Nothing else is needed for them.  */
+    if (attrs & TLMU_REGION_RAM) {
+        tlm_map_ram(name, addr, size, 1);
+        return;
+    }
+    if (attrs & TLMU_REGION_EXEC) {
+        tlm_map_ram(name, addr, size, 0);
+        return;
+    }
+
+    r = g_malloc0(sizeof *r);
+    r->base = addr;
+    r->size = size;
+    r->attrs = attrs;
+    if (attrs & TLMU_REGION_READ_CACHE) {
+        r->shadow = g_malloc0(size);
+        r->shadow_valid = bitmap_new(size);
+    }
+
+    /* Insert.  */
+    r->next = tlm_regions;
+    tlm_regions = r;
+}
+
 void tlm_register_rams(void)
 {
     struct TLMRegisterRamEntry *ram;
@@ -89,6 +89,8 @@ typedef struct IOTrampoline
     guint tag;
 } IOTrampoline;
 
+static IOTrampoline fd_trampolines[FD_SETSIZE];
+
 static gboolean fd_trampoline(GIOChannel *chan, GIOCondition cond, gpointer opaque)
 {
     IOTrampoline *tramp = opaque;
@@ -113,7 +115,6 @@ int qemu_set_fd_handler(int fd,
                         IOHandler *fd_write,
                         void *opaque)
 {
-    static IOTrampoline fd_trampolines[FD_SETSIZE];
     IOTrampoline *tramp = &fd_trampolines[fd];
 
     if (tramp->tag != 0) {
@@ -143,6 +144,29 @@ int qemu_set_fd_handler(int fd,
     return 0;
 }
 
+/* Drop every file descriptor handler.  A child forked from a running
+   instance must not read from descriptors that still belong to its
+   parent; it registers its own ones again afterwards.  */
+void qemu_iohandler_clear(void)
+{
+    IOHandlerRecord *ioh;
+    IOTrampoline *tramp;
+    int fd;
+
+    QLIST_FOREACH(ioh, &io_handlers, next) {
+        ioh->deleted = 1;
+    }
+    for (fd = 0; fd < FD_SETSIZE; fd++) {
+        tramp = &fd_trampolines[fd];
+        if (tramp->tag != 0) {
+            g_io_channel_unref(tramp->chan);
+            g_source_remove(tramp->tag);
+            tramp->tag = 0;
+            tramp->opaque = NULL;
+        }
+    }
+}
+
 void qemu_iohandler_fill(int *pnfds, fd_set *readfds, fd_set *writefds, fd_set *xfds)
 {
     IOHandlerRecord *ioh;
@@ -63,6 +63,8 @@
 #endif
 #include "trace/control.h"
 #include "ui/qemu-spice.h"
+#include "qemu-stats.h"
+#include "fork-server.h"
 
 //#define DEBUG
 //#define DEBUG_COMPLETION
@@ -2905,6 +2907,14 @@ static const mon_cmd_t info_cmds[] = {
         .user_print = bdrv_stats_print,
         .mhandler.info_new = bdrv_info_stats,
     },
+    {
+        .name       = "stats",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show performance counters and their change since the last query",
+        .user_print = do_info_stats_print,
+        .mhandler.info_new = do_info_stats,
+    },
     {
         .name       = "registers",
         .args_type  = "",
@@ -3204,6 +3214,14 @@ static const mon_cmd_t qmp_query_cmds[] = {
         .user_print = bdrv_stats_print,
         .mhandler.info_new = bdrv_info_stats,
     },
+    {
+        .name       = "stats",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show performance counters and their change since the last query",
+        .user_print = do_info_stats_print,
+        .mhandler.info_new = do_info_stats,
+    },
     {
         .name       = "cpus",
         .args_type  = "",
@@ -5212,6 +5230,10 @@ static void monitor_control_event(void *opaque, int event)
         break;
     case CHR_EVENT_CLOSED:
         json_message_parser_destroy(&mon->mc->parser);
+        if (mon->flags & MONITOR_QUIT_ON_CLOSE) {
+            no_shutdown = 0;
+            qemu_system_shutdown_request();
+        }
         break;
     }
 }
@@ -5300,6 +5322,20 @@ void monitor_init(CharDriverState *chr, int flags)
         default_mon = mon;
 }
 
+/* A forked clone must not answer, or send events, on the parent's
+   sessions.  Forget the inherited monitors before its own is set up.  */
+void monitor_fork_child(void)
+{
+    Monitor *mon, *next;
+
+    QLIST_FOREACH_SAFE(mon, &mon_list, entry, next) {
+        QLIST_REMOVE(mon, entry);
+        qemu_chr_add_handlers(mon->chr, NULL, NULL, NULL, NULL);
+    }
+    default_mon = NULL;
+    cur_mon = NULL;
+}
+
 static void bdrv_password_cb(Monitor *mon, const char *password, void *opaque)
 {
     BlockDriverState *bs = opaque;
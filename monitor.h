@@ -15,6 +15,7 @@ extern Monitor *default_mon;
 #define MONITOR_USE_READLINE  0x02
 #define MONITOR_USE_CONTROL   0x04
 #define MONITOR_USE_PRETTY    0x08
+#define MONITOR_QUIT_ON_CLOSE 0x10
 
 /* flags for monitor commands */
 #define MONITOR_CMD_ASYNC       0x0001
@@ -42,6 +43,7 @@ int monitor_cur_is_qmp(void);
 
 void monitor_protocol_event(MonitorEvent event, QObject *data);
 void monitor_init(CharDriverState *chr, int flags);
+void monitor_fork_child(void);
 
 int monitor_suspend(Monitor *mon);
 void monitor_resume(Monitor *mon);
@@ -546,121 +546,252 @@ static int nbd_send_reply(int csock, struct nbd_reply *reply)
     return 0;
 }
 
-int nbd_trip(BlockDriverState *bs, int csock, off_t size, uint64_t dev_offset,
-             off_t *offset, bool readonly, uint8_t *data, int data_size)
+/* Server side.  Each client socket is watched with the AIO fd handlers;
+   every request runs in its own coroutine, so that while one request
+   waits for the block layer the next one can already be read from the
+   same socket or from another client.  Replies are sent as soon as a
+   request completes, which may be out of order; clients match them by
+   handle.  Socket reads and writes stay blocking and never yield, so
+   requests and replies are never interleaved on the wire.  */
+
+#define NBD_MAX_BUFFER_SIZE     (1024 * 1024)
+#define NBD_MAX_REQUESTS        16
+
+struct NBDExport {
+    BlockDriverState *bs;
+    off_t dev_offset;
+    off_t size;
+    bool readonly;
+};
+
+struct NBDClient {
+    NBDExport *exp;
+    int sock;
+    void (*close)(NBDClient *client, void *opaque);
+    void *opaque;
+    int nb_requests;
+    bool closing;
+};
+
+NBDExport *nbd_export_new(BlockDriverState *bs, off_t dev_offset,
+                          off_t size, bool readonly)
 {
+    NBDExport *exp = g_malloc0(sizeof(NBDExport));
+
+    exp->bs = bs;
+    exp->dev_offset = dev_offset;
+    exp->size = size;
+    exp->readonly = readonly;
+    return exp;
+}
+
+void nbd_export_close(NBDExport *exp)
+{
+    g_free(exp);
+}
+
+static void nbd_read(void *opaque);
+
+static void nbd_client_update_handler(NBDClient *client)
+{
+    bool can_read = !client->closing &&
+                    client->nb_requests < NBD_MAX_REQUESTS;
+
+    qemu_aio_set_fd_handler(client->sock, can_read ? nbd_read : NULL,
+                            NULL, NULL, NULL, client);
+}
+
+static void nbd_client_put(NBDClient *client)
+{
+    if (!client->closing || client->nb_requests > 0) {
+        return;
+    }
+    close(client->sock);
+    if (client->close) {
+        client->close(client, client->opaque);
+    }
+    g_free(client);
+}
+
+static void nbd_client_close(NBDClient *client)
+{
+    client->closing = true;
+    nbd_client_update_handler(client);
+}
+
+static int nbd_co_send_reply(NBDClient *client, struct nbd_reply *reply,
+                             uint8_t *data, int len)
+{
+    if (client->closing) {
+        return -1;
+    }
+    if (len == 0) {
+        return nbd_send_reply(client->sock, reply);
+    }
+
+    /* data has NBD_REPLY_SIZE bytes of headroom for the header */
+    cpu_to_be32w((uint32_t*)data, NBD_REPLY_MAGIC);
+    cpu_to_be32w((uint32_t*)(data + 4), reply->error);
+    cpu_to_be64w((uint64_t*)(data + 8), reply->handle);
+    if (write_sync(client->sock, data, len + NBD_REPLY_SIZE) !=
+        len + NBD_REPLY_SIZE) {
+        LOG("writing to socket failed");
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static void coroutine_fn nbd_co_trip(void *opaque)
+{
+    NBDClient *client = opaque;
+    NBDExport *exp = client->exp;
     struct nbd_request request;
     struct nbd_reply reply;
+    QEMUIOVector qiov;
+    struct iovec iov;
+    uint8_t *data = NULL;
+    int ret;
 
     TRACE("Reading request.");
 
-    if (nbd_receive_request(csock, &request) == -1)
-        return -1;
+    client->nb_requests++;
+    if (nbd_receive_request(client->sock, &request) == -1) {
+        goto out_close;
+    }
 
-    if (request.len + NBD_REPLY_SIZE > data_size) {
+    if (request.len > NBD_MAX_BUFFER_SIZE) {
         LOG("len (%u) is larger than max len (%u)",
-            request.len + NBD_REPLY_SIZE, data_size);
-        errno = EINVAL;
-        return -1;
+            request.len, NBD_MAX_BUFFER_SIZE);
+        goto out_close;
     }
 
     if ((request.from + request.len) < request.from) {
         LOG("integer overflow detected! "
             "you're probably being attacked");
-        errno = EINVAL;
-        return -1;
+        goto out_close;
     }
 
-    if ((request.from + request.len) > size) {
-            LOG("From: %" PRIu64 ", Len: %u, Size: %" PRIu64
+    if ((request.from + request.len) > exp->size) {
+        LOG("From: %" PRIu64 ", Len: %u, Size: %" PRIu64
             ", Offset: %" PRIu64 "\n",
-                    request.from, request.len, (uint64_t)size, dev_offset);
+            request.from, request.len, (uint64_t)exp->size,
+            (uint64_t)exp->dev_offset);
         LOG("requested operation past EOF--bad client?");
-        errno = EINVAL;
-        return -1;
+        goto out_close;
     }
 
-    TRACE("Decoding type");
-
     reply.handle = request.handle;
     reply.error = 0;
 
-    switch (request.type) {
-    case NBD_CMD_READ:
-        TRACE("Request type is READ");
+    if (request.type == NBD_CMD_DISC) {
+        TRACE("Request type is DISCONNECT");
+        goto out_close;
+    }
+    if (request.type != NBD_CMD_READ && request.type != NBD_CMD_WRITE) {
+        LOG("invalid request type (%u) received", request.type);
+        goto out_close;
+    }
 
-        if (bdrv_read(bs, (request.from + dev_offset) / 512,
-                  data + NBD_REPLY_SIZE,
-                  request.len / 512) == -1) {
-            LOG("reading from file failed");
-            errno = EINVAL;
-            return -1;
-        }
-        *offset += request.len;
+    data = qemu_blockalign(exp->bs, request.len + NBD_REPLY_SIZE);
+    iov.iov_base = data + NBD_REPLY_SIZE;
+    iov.iov_len = request.len;
+    qemu_iovec_init_external(&qiov, &iov, 1);
 
-        TRACE("Read %u byte(s)", request.len);
+    if (request.type == NBD_CMD_WRITE) {
+        TRACE("Reading %u byte(s)", request.len);
 
-        /* Reply
-           [ 0 ..  3]    magic   (NBD_REPLY_MAGIC)
-           [ 4 ..  7]    error   (0 == no error)
-           [ 7 .. 15]    handle
-         */
+        if (read_sync(client->sock, iov.iov_base, request.len) !=
+            request.len) {
+            LOG("reading from socket failed");
+            goto out_close;
+        }
+    }
 
-        cpu_to_be32w((uint32_t*)data, NBD_REPLY_MAGIC);
-        cpu_to_be32w((uint32_t*)(data + 4), reply.error);
-        cpu_to_be64w((uint64_t*)(data + 8), reply.handle);
+    /* The request is off the wire, let the next one in while the
+       block layer works on this one.  */
+    nbd_client_update_handler(client);
 
-        TRACE("Sending data to client");
+    switch (request.type) {
+    case NBD_CMD_READ:
+        TRACE("Request type is READ");
 
-        if (write_sync(csock, data,
-                   request.len + NBD_REPLY_SIZE) !=
-                   request.len + NBD_REPLY_SIZE) {
-            LOG("writing to socket failed");
-            errno = EINVAL;
-            return -1;
+        ret = bdrv_co_readv(exp->bs, (request.from + exp->dev_offset) / 512,
+                            request.len / 512, &qiov);
+        if (ret < 0) {
+            LOG("reading from file failed");
+            reply.error = -ret;
+            ret = nbd_co_send_reply(client, &reply, NULL, 0);
+        } else {
+            TRACE("Read %u byte(s)", request.len);
+            ret = nbd_co_send_reply(client, &reply, data, request.len);
         }
         break;
     case NBD_CMD_WRITE:
         TRACE("Request type is WRITE");
 
-        TRACE("Reading %u byte(s)", request.len);
-
-        if (read_sync(csock, data, request.len) != request.len) {
-            LOG("reading from socket failed");
-            errno = EINVAL;
-            return -1;
-        }
-
-        if (readonly) {
+        if (exp->readonly) {
             TRACE("Server is read-only, return error");
             reply.error = 1;
         } else {
             TRACE("Writing to device");
 
-            if (bdrv_write(bs, (request.from + dev_offset) / 512,
-                       data, request.len / 512) == -1) {
+            ret = bdrv_co_writev(exp->bs,
+                                 (request.from + exp->dev_offset) / 512,
+                                 request.len / 512, &qiov);
+            if (ret < 0) {
                 LOG("writing to file failed");
-                errno = EINVAL;
-                return -1;
+                reply.error = -ret;
             }
-
-            *offset += request.len;
         }
-
-        if (nbd_send_reply(csock, &reply) == -1)
-            return -1;
+        ret = nbd_co_send_reply(client, &reply, NULL, 0);
         break;
-    case NBD_CMD_DISC:
-        TRACE("Request type is DISCONNECT");
-        errno = 0;
-        return 1;
     default:
-        LOG("invalid request type (%u) received", request.type);
-        errno = EINVAL;
-        return -1;
+        abort();
+    }
+    if (ret < 0) {
+        goto out_close;
     }
 
     TRACE("Request/Reply complete");
+    goto out;
+
+out_close:
+    nbd_client_close(client);
+out:
+    qemu_vfree(data);
+    client->nb_requests--;
+    if (!client->closing) {
+        nbd_client_update_handler(client);
+    }
+    nbd_client_put(client);
+}
 
-    return 0;
+static void nbd_read(void *opaque)
+{
+    NBDClient *client = opaque;
+    Coroutine *co;
+
+    /* Stop watching the socket until the coroutine has read the
+       request, it re-arms the handler itself.  */
+    qemu_aio_set_fd_handler(client->sock, NULL, NULL, NULL, NULL, client);
+    co = qemu_coroutine_create(nbd_co_trip);
+    qemu_coroutine_enter(co, client);
+}
+
+NBDClient *nbd_client_new(NBDExport *exp, int csock,
+                          void (*close_fn)(NBDClient *, void *), void *opaque)
+{
+    NBDClient *client;
+
+    if (nbd_negotiate(csock, exp->size) == -1) {
+        return NULL;
+    }
+    client = g_malloc0(sizeof(NBDClient));
+    client->exp = exp;
+    client->sock = csock;
+    client->close = close_fn;
+    client->opaque = opaque;
+    nbd_client_update_handler(client);
+    return client;
 }
@@ -36,6 +36,7 @@
 #include "qemu_socket.h"
 #include "hw/qdev.h"
 #include "iov.h"
+#include "qemu-stats.h"
 
 static QTAILQ_HEAD(, VLANState) vlans;
 static QTAILQ_HEAD(, VLANClientState) non_vlan_clients;
@@ -382,6 +383,14 @@ int qemu_can_send_packet(VLANClientState *sender)
     return 1;
 }
 
+static inline void qemu_net_account(VLANClientState *vc, ssize_t len)
+{
+    if (len > 0) {
+        vc->rx_packets++;
+        vc->rx_bytes += len;
+    }
+}
+
 static ssize_t qemu_deliver_packet(VLANClientState *sender,
                                    unsigned flags,
                                    const uint8_t *data,
@@ -404,6 +413,7 @@ static ssize_t qemu_deliver_packet(VLANClientState *sender,
     } else {
         ret = vc->info->receive(vc, data, size);
     }
+    qemu_net_account(vc, ret);
 
     if (ret == 0) {
         vc->receive_disabled = 1;
@@ -444,6 +454,7 @@ static ssize_t qemu_vlan_deliver_packet(VLANClientState *sender,
         } else {
             len = vc->info->receive(vc, buf, size);
         }
+        qemu_net_account(vc, len);
 
         if (len == 0) {
             vc->receive_disabled = 1;
@@ -550,16 +561,19 @@ static ssize_t qemu_deliver_packet_iov(VLANClientState *sender,
                                        void *opaque)
 {
     VLANClientState *vc = opaque;
+    ssize_t ret;
 
     if (vc->link_down) {
         return iov_size(iov, iovcnt);
     }
 
     if (vc->info->receive_iov) {
-        return vc->info->receive_iov(vc, iov, iovcnt);
+        ret = vc->info->receive_iov(vc, iov, iovcnt);
     } else {
-        return vc_sendv_compat(vc, iov, iovcnt);
+        ret = vc_sendv_compat(vc, iov, iovcnt);
     }
+    qemu_net_account(vc, ret);
+    return ret;
 }
 
 static ssize_t qemu_vlan_deliver_packet_iov(VLANClientState *sender,
@@ -591,6 +605,7 @@ static ssize_t qemu_vlan_deliver_packet_iov(VLANClientState *sender,
         } else {
             len = vc_sendv_compat(vc, iov, iovcnt);
         }
+        qemu_net_account(vc, len);
 
         ret = (ret >= 0) ? ret : len;
     }
@@ -1396,6 +1411,27 @@ static int net_init_client(QemuOpts *opts, void *dummy)
     return 0;
 }
 
+static void net_stats_client(QDict *dict, VLANClientState *vc)
+{
+    qemu_stats_put(dict, vc->name, "rx_packets", vc->rx_packets);
+    qemu_stats_put(dict, vc->name, "rx_bytes", vc->rx_bytes);
+}
+
+static void net_stats(QDict *dict, void *opaque)
+{
+    VLANState *vlan;
+    VLANClientState *vc;
+
+    QTAILQ_FOREACH(vlan, &vlans, next) {
+        QTAILQ_FOREACH(vc, &vlan->clients, next) {
+            net_stats_client(dict, vc);
+        }
+    }
+    QTAILQ_FOREACH(vc, &non_vlan_clients, next) {
+        net_stats_client(dict, vc);
+    }
+}
+
 static int net_init_netdev(QemuOpts *opts, void *dummy)
 {
     return net_client_init(NULL, opts, 1);
@@ -1415,6 +1451,7 @@ int net_init_clients(void)
 
     QTAILQ_INIT(&vlans);
     QTAILQ_INIT(&non_vlan_clients);
+    qemu_stats_register("net", net_stats, NULL);
 
     if (qemu_opts_foreach(qemu_find_opts("netdev"), net_init_netdev, NULL, 1) == -1)
         return -1;
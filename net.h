@@ -70,6 +70,9 @@ struct VLANClientState {
     char *name;
     char info_str[256];
     unsigned receive_disabled : 1;
+    /* delivered to this client, see query-stats */
+    uint64_t rx_packets;
+    uint64_t rx_bytes;
 };
 
 typedef struct NICState {
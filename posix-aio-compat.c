@@ -709,3 +709,43 @@ int paio_init(void)
     posix_aio_state = s;
     return 0;
 }
+
+/* Called in a child forked from a running instance with no request in
+   flight.  None of the worker threads exist in the child and one of them
+   may have held the lock at the time of the fork; the completion pipe is
+   still shared with the parent, which would miss the wakeups that the
+   child reads.  */
+int paio_fork_child(void)
+{
+    PosixAioState *s = posix_aio_state;
+    int fds[2];
+
+    if (!s)
+        return 0;
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+    cur_threads = 0;
+    idle_threads = 0;
+    new_threads = 0;
+    pending_threads = 0;
+
+    qemu_aio_set_fd_handler(s->rfd, NULL, NULL, NULL, NULL, NULL);
+    close(s->rfd);
+    close(s->wfd);
+
+    if (qemu_pipe(fds) == -1) {
+        fprintf(stderr, "failed to create pipe\n");
+        return -1;
+    }
+
+    s->rfd = fds[0];
+    s->wfd = fds[1];
+
+    fcntl(s->rfd, F_SETFL, O_NONBLOCK);
+    fcntl(s->wfd, F_SETFL, O_NONBLOCK);
+
+    qemu_aio_set_fd_handler(s->rfd, posix_aio_read, NULL, posix_aio_flush,
+        posix_aio_process_queue, s);
+    return 0;
+}
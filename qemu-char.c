@@ -139,13 +139,83 @@ void qemu_chr_generic_open(CharDriverState *s)
     }
 }
 
+/* Output coalescing.  A device created with coalesce=N collects the
+   bytes written by its front end in an N byte buffer, and hands them to
+   the backend in one chr_write call on a newline, when the buffer is
+   full, CHR_FLUSH_MS after the first buffered byte, or before the front
+   end is given input or an ioctl.  */
+#define CHR_FLUSH_MS        10
+#define CHR_MAX_COALESCE    65536
+
+static void qemu_chr_flush(CharDriverState *s)
+{
+    int ret;
+
+    if (s->wbuf_len == 0) {
+        return;
+    }
+    ret = s->chr_write(s, s->wbuf, s->wbuf_len);
+    if (ret < 0 || ret >= s->wbuf_len) {
+        /* written, or dropped as an unbuffered write would have been */
+        s->wbuf_len = 0;
+    } else if (ret > 0) {
+        memmove(s->wbuf, s->wbuf + ret, s->wbuf_len - ret);
+        s->wbuf_len -= ret;
+    }
+
+    if (s->wbuf_len == 0) {
+        qemu_del_timer(s->wbuf_timer);
+    } else if (!qemu_timer_pending(s->wbuf_timer)) {
+        qemu_mod_timer(s->wbuf_timer,
+                       qemu_get_clock_ms(rt_clock) + CHR_FLUSH_MS);
+    }
+}
+
+static void qemu_chr_flush_timer(void *opaque)
+{
+    qemu_chr_flush(opaque);
+}
+
+static int qemu_chr_write_coalesced(CharDriverState *s,
+                                    const uint8_t *buf, int len)
+{
+    int done = 0, n;
+
+    while (done < len) {
+        if (s->wbuf_len == s->wbuf_size) {
+            qemu_chr_flush(s);
+            if (s->wbuf_len == s->wbuf_size) {
+                /* the backend is not taking data, report what was
+                   accepted so far */
+                break;
+            }
+        }
+        n = MIN(len - done, s->wbuf_size - s->wbuf_len);
+        memcpy(s->wbuf + s->wbuf_len, buf + done, n);
+        s->wbuf_len += n;
+        done += n;
+    }
+
+    if (s->wbuf_len == s->wbuf_size || memchr(buf, '\n', done)) {
+        qemu_chr_flush(s);
+    } else if (s->wbuf_len && !qemu_timer_pending(s->wbuf_timer)) {
+        qemu_mod_timer(s->wbuf_timer,
+                       qemu_get_clock_ms(rt_clock) + CHR_FLUSH_MS);
+    }
+    return done;
+}
+
 int qemu_chr_fe_write(CharDriverState *s, const uint8_t *buf, int len)
 {
+    if (s->wbuf_size) {
+        return qemu_chr_write_coalesced(s, buf, len);
+    }
     return s->chr_write(s, buf, len);
 }
 
 int qemu_chr_fe_ioctl(CharDriverState *s, int cmd, void *arg)
 {
+    qemu_chr_flush(s);
     if (!s->chr_ioctl)
         return -ENOTSUP;
     return s->chr_ioctl(s, cmd, arg);
@@ -160,6 +230,8 @@ int qemu_chr_be_can_write(CharDriverState *s)
 
 void qemu_chr_be_write(CharDriverState *s, uint8_t *buf, int len)
 {
+    /* let pending output (e.g. a prompt) out before the reply to it */
+    qemu_chr_flush(s);
     s->chr_read(s->handler_opaque, buf, len);
 }
 
@@ -218,6 +290,26 @@ static int null_chr_write(CharDriverState *chr, const uint8_t *buf, int len)
     return len;
 }
 
+#ifndef _WIN32
+/* Let go of a descriptor shared with the fork parent.  The slot is kept
+   on /dev/null so that nothing opened later by the child ends up where
+   stdio or a backend still expects its old file.  */
+static void qemu_chr_fork_drop_fd(int fd)
+{
+    int null_fd;
+
+    if (fd < 0) {
+        return;
+    }
+    null_fd = open("/dev/null", O_RDWR);
+    if (null_fd < 0) {
+        return;
+    }
+    dup2(null_fd, fd);
+    close(null_fd);
+}
+#endif
+
 static int qemu_chr_open_null(QemuOpts *opts, CharDriverState **_chr)
 {
     CharDriverState *chr;
@@ -615,6 +707,14 @@ static void fd_chr_close(struct CharDriverState *chr)
     qemu_chr_event(chr, CHR_EVENT_CLOSED);
 }
 
+static void fd_chr_fork_child(struct CharDriverState *chr)
+{
+    FDCharDriver *s = chr->opaque;
+
+    qemu_chr_fork_drop_fd(s->fd_in);
+    qemu_chr_fork_drop_fd(s->fd_out);
+}
+
 /* open a character device to a unix fd */
 static CharDriverState *qemu_chr_open_fd(int fd_in, int fd_out)
 {
@@ -629,6 +729,7 @@ static CharDriverState *qemu_chr_open_fd(int fd_in, int fd_out)
     chr->chr_write = fd_chr_write;
     chr->chr_update_read_handler = fd_chr_update_read_handler;
     chr->chr_close = fd_chr_close;
+    chr->chr_fork_child = fd_chr_fork_child;
 
     qemu_chr_generic_open(chr);
 
@@ -979,6 +1080,14 @@ static void pty_chr_close(struct CharDriverState *chr)
     qemu_chr_event(chr, CHR_EVENT_CLOSED);
 }
 
+static void pty_chr_fork_child(struct CharDriverState *chr)
+{
+    PtyCharDriver *s = chr->opaque;
+
+    qemu_del_timer(s->timer);
+    qemu_chr_fork_drop_fd(s->fd);
+}
+
 static int qemu_chr_open_pty(QemuOpts *opts, CharDriverState **_chr)
 {
     CharDriverState *chr;
@@ -1016,6 +1125,7 @@ static int qemu_chr_open_pty(QemuOpts *opts, CharDriverState **_chr)
     chr->chr_write = pty_chr_write;
     chr->chr_update_read_handler = pty_chr_update_read_handler;
     chr->chr_close = pty_chr_close;
+    chr->chr_fork_child = pty_chr_fork_child;
 
     s->timer = qemu_new_timer_ms(rt_clock, pty_chr_timer, chr);
 
@@ -1356,6 +1466,14 @@ static void pp_close(CharDriverState *chr)
     qemu_chr_event(chr, CHR_EVENT_CLOSED);
 }
 
+/* The port stays claimed by the parent.  */
+static void pp_fork_child(CharDriverState *chr)
+{
+    ParallelCharDriver *drv = chr->opaque;
+
+    qemu_chr_fork_drop_fd(drv->fd);
+}
+
 static int qemu_chr_open_pp(QemuOpts *opts, CharDriverState **_chr)
 {
     const char *filename = qemu_opt_get(opts, "path");
@@ -1381,6 +1499,7 @@ static int qemu_chr_open_pp(QemuOpts *opts, CharDriverState **_chr)
     chr->chr_write = null_chr_write;
     chr->chr_ioctl = pp_ioctl;
     chr->chr_close = pp_close;
+    chr->chr_fork_child = pp_fork_child;
     chr->opaque = drv;
 
     qemu_chr_generic_open(chr);
@@ -1888,6 +2007,15 @@ static void udp_chr_close(CharDriverState *chr)
     qemu_chr_event(chr, CHR_EVENT_CLOSED);
 }
 
+#ifndef _WIN32
+static void udp_chr_fork_child(CharDriverState *chr)
+{
+    NetCharDriver *s = chr->opaque;
+
+    qemu_chr_fork_drop_fd(s->fd);
+}
+#endif
+
 static int qemu_chr_open_udp(QemuOpts *opts, CharDriverState **_chr)
 {
     CharDriverState *chr = NULL;
@@ -1912,6 +2040,9 @@ static int qemu_chr_open_udp(QemuOpts *opts, CharDriverState **_chr)
     chr->chr_write = udp_chr_write;
     chr->chr_update_read_handler = udp_chr_update_read_handler;
     chr->chr_close = udp_chr_close;
+#ifndef _WIN32
+    chr->chr_fork_child = udp_chr_fork_child;
+#endif
 
     *_chr = chr;
     return 0;
@@ -2213,17 +2344,61 @@ static void tcp_chr_close(CharDriverState *chr)
     qemu_chr_event(chr, CHR_EVENT_CLOSED);
 }
 
+#ifndef _WIN32
+static void tcp_chr_fork_child(CharDriverState *chr)
+{
+    TCPCharDriver *s = chr->opaque;
+
+    qemu_chr_fork_drop_fd(s->fd);
+    qemu_chr_fork_drop_fd(s->listen_fd);
+}
+#endif
+
+static CharDriverState *tcp_chr_new(int is_unix, int do_nodelay)
+{
+    CharDriverState *chr;
+    TCPCharDriver *s;
+
+    chr = g_malloc0(sizeof(CharDriverState));
+    s = g_malloc0(sizeof(TCPCharDriver));
+
+    s->connected = 0;
+    s->fd = -1;
+    s->listen_fd = -1;
+    s->msgfd = -1;
+    s->is_unix = is_unix;
+    s->do_nodelay = do_nodelay;
+
+    chr->opaque = s;
+    chr->chr_write = tcp_chr_write;
+    chr->chr_close = tcp_chr_close;
+    chr->get_msgfd = tcp_get_msgfd;
+    chr->chr_add_client = tcp_chr_add_client;
+#ifndef _WIN32
+    chr->chr_fork_child = tcp_chr_fork_child;
+#endif
+    return chr;
+}
+
+CharDriverState *qemu_chr_open_socket_fd(int fd, int is_unix)
+{
+    CharDriverState *chr;
+
+    chr = tcp_chr_new(is_unix, !is_unix);
+    tcp_chr_add_client(chr, fd);
+    return chr;
+}
+
 static int qemu_chr_open_socket(QemuOpts *opts, CharDriverState **_chr)
 {
-    CharDriverState *chr = NULL;
-    TCPCharDriver *s = NULL;
-    int fd = -1;
+    CharDriverState *chr;
+    TCPCharDriver *s;
+    int fd;
     int is_listen;
     int is_waitconnect;
     int do_nodelay;
     int is_unix;
     int is_telnet;
-    int ret;
 
     is_listen      = qemu_opt_get_bool(opts, "server", 0);
     is_waitconnect = qemu_opt_get_bool(opts, "wait", 1);
@@ -2233,9 +2408,6 @@ static int qemu_chr_open_socket(QemuOpts *opts, CharDriverState **_chr)
     if (!is_listen)
         is_waitconnect = 0;
 
-    chr = g_malloc0(sizeof(CharDriverState));
-    s = g_malloc0(sizeof(TCPCharDriver));
-
     if (is_unix) {
         if (is_listen) {
             fd = unix_listen_opts(opts);
@@ -2250,25 +2422,14 @@ static int qemu_chr_open_socket(QemuOpts *opts, CharDriverState **_chr)
         }
     }
     if (fd < 0) {
-        ret = -errno;
-        goto fail;
+        return -errno;
     }
 
     if (!is_waitconnect)
         socket_set_nonblock(fd);
 
-    s->connected = 0;
-    s->fd = -1;
-    s->listen_fd = -1;
-    s->msgfd = -1;
-    s->is_unix = is_unix;
-    s->do_nodelay = do_nodelay && !is_unix;
-
-    chr->opaque = s;
-    chr->chr_write = tcp_chr_write;
-    chr->chr_close = tcp_chr_close;
-    chr->get_msgfd = tcp_get_msgfd;
-    chr->chr_add_client = tcp_chr_add_client;
+    chr = tcp_chr_new(is_unix, do_nodelay && !is_unix);
+    s = chr->opaque;
 
     if (is_listen) {
         s->listen_fd = fd;
@@ -2308,13 +2469,6 @@ static int qemu_chr_open_socket(QemuOpts *opts, CharDriverState **_chr)
 
     *_chr = chr;
     return 0;
-
- fail:
-    if (fd >= 0)
-        closesocket(fd);
-    g_free(s);
-    g_free(chr);
-    return ret;
 }
 
 /***********************************************************/
@@ -2546,6 +2700,7 @@ CharDriverState *qemu_chr_new_from_opts(QemuOpts *opts,
                                     void (*init)(struct CharDriverState *s))
 {
     CharDriverState *chr;
+    uint64_t coalesce;
     int i;
     int ret;
 
@@ -2594,6 +2749,14 @@ CharDriverState *qemu_chr_new_from_opts(QemuOpts *opts,
         chr->avail_connections = 1;
     }
     chr->label = g_strdup(qemu_opts_id(opts));
+
+    coalesce = qemu_opt_get_number(opts, "coalesce", 0);
+    if (coalesce) {
+        chr->wbuf_size = MIN(coalesce, CHR_MAX_COALESCE);
+        chr->wbuf = g_malloc(chr->wbuf_size);
+        chr->wbuf_timer = qemu_new_timer_ms(rt_clock, qemu_chr_flush_timer,
+                                            chr);
+    }
     return chr;
 }
 
@@ -2642,6 +2805,11 @@ void qemu_chr_fe_close(struct CharDriverState *chr)
 
 void qemu_chr_delete(CharDriverState *chr)
 {
+    qemu_chr_flush(chr);
+    if (chr->wbuf_timer) {
+        qemu_free_timer(chr->wbuf_timer);
+        g_free(chr->wbuf);
+    }
     QTAILQ_REMOVE(&chardevs, chr, next);
     if (chr->chr_close)
         chr->chr_close(chr);
@@ -2650,6 +2818,40 @@ void qemu_chr_delete(CharDriverState *chr)
     g_free(chr);
 }
 
+#ifndef _WIN32
+/* A forked clone keeps every chardev its devices point to, but none of
+   them may read from or write to the parent's terminal, socket or file.
+   They all become null devices, without a CLOSED event to the front end
+   and without touching the other end of the connection.  */
+void qemu_chr_fork_child(void)
+{
+    CharDriverState *chr;
+
+    QTAILQ_FOREACH(chr, &chardevs, next) {
+        if (chr->chr_fork_child) {
+            chr->chr_fork_child(chr);
+        }
+        if (chr->wbuf_timer) {
+            qemu_del_timer(chr->wbuf_timer);
+        }
+        chr->wbuf_len = 0;
+        chr->chr_write = null_chr_write;
+        chr->chr_update_read_handler = NULL;
+        chr->chr_ioctl = NULL;
+        chr->get_msgfd = NULL;
+        chr->chr_add_client = NULL;
+        chr->chr_close = NULL;
+        chr->chr_accept_input = NULL;
+        chr->chr_set_echo = NULL;
+        chr->chr_guest_open = NULL;
+        chr->chr_guest_close = NULL;
+        chr->chr_fork_child = NULL;
+        g_free(chr->filename);
+        chr->filename = g_strdup("null");
+    }
+}
+#endif
+
 static void qemu_chr_qlist_iter(QObject *obj, void *opaque)
 {
     QDict *chr_dict;
@@ -67,12 +67,18 @@ struct CharDriverState {
     void (*chr_set_echo)(struct CharDriverState *chr, bool echo);
     void (*chr_guest_open)(struct CharDriverState *chr);
     void (*chr_guest_close)(struct CharDriverState *chr);
+    void (*chr_fork_child)(struct CharDriverState *chr);
     void *opaque;
     QEMUBH *bh;
     char *label;
     char *filename;
     int opened;
     int avail_connections;
+    /* front end output coalescing (coalesce=N), see qemu_chr_fe_write */
+    uint8_t *wbuf;
+    int wbuf_len;
+    int wbuf_size;
+    QEMUTimer *wbuf_timer;
     QTAILQ_ENTRY(CharDriverState) next;
 };
 
@@ -229,6 +235,12 @@ QemuOpts *qemu_chr_parse_compat(const char *label, const char *filename);
 /* add an eventfd to the qemu devices that are polled */
 CharDriverState *qemu_chr_open_eventfd(int eventfd);
 
+/* wrap a connected stream socket */
+CharDriverState *qemu_chr_open_socket_fd(int fd, int is_unix);
+
+/* detach all backends from the endpoints shared with a fork parent */
+void qemu_chr_fork_child(void);
+
 extern int term_escape_char;
 
 /* memory chardev */
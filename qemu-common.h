@@ -213,6 +213,7 @@ typedef int IOCanReadHandler(void *opaque);
 typedef void IOHandler(void *opaque);
 
 void qemu_iohandler_fill(int *pnfds, fd_set *readfds, fd_set *writefds, fd_set *xfds);
+void qemu_iohandler_clear(void);
 void qemu_iohandler_poll(fd_set *readfds, fd_set *writefds, fd_set *xfds, int rc);
 
 struct ParallelIOArg {
@@ -158,6 +158,9 @@ static QemuOptsList qemu_chardev_opts = {
         },{
             .name = "debug",
             .type = QEMU_OPT_NUMBER,
+        },{
+            .name = "coalesce",
+            .type = QEMU_OPT_NUMBER,
         },
         { /* end of list */ }
     },
@@ -477,6 +480,22 @@ static QemuOptsList qemu_machine_opts = {
             .name = "accel",
             .type = QEMU_OPT_STRING,
             .help = "accelerator list",
+        }, {
+            .name = "mem-hugepage",
+            .type = QEMU_OPT_BOOL,
+            .help = "back guest RAM with transparent huge pages",
+        }, {
+            .name = "mem-prealloc",
+            .type = QEMU_OPT_BOOL,
+            .help = "fault in guest RAM at startup",
+        }, {
+            .name = "mem-host-node",
+            .type = QEMU_OPT_NUMBER,
+            .help = "bind guest RAM to this host NUMA node",
+        }, {
+            .name = "mem-shared",
+            .type = QEMU_OPT_BOOL,
+            .help = "back guest RAM with a shared memfd",
         },
         { /* End of list */ }
     },
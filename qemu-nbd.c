@@ -34,9 +34,12 @@
 
 #define SOCKET_PATH    "/var/lock/qemu-nbd-%s"
 
-#define NBD_BUFFER_SIZE (1024*1024)
-
 static int verbose;
+static int shared = 1;
+static int nb_fds;
+static bool nbd_started;
+static int server_fd;
+static NBDExport *nbd_export;
 
 static void usage(const char *name)
 {
@@ -180,17 +183,48 @@ static void show_parts(const char *device)
     }
 }
 
+static void nbd_accept(void *opaque);
+
+/* Stop accepting connections while all 'shared' slots are taken.  */
+static void nbd_update_server_fd_handler(void)
+{
+    qemu_aio_set_fd_handler(server_fd, nb_fds < shared ? nbd_accept : NULL,
+                            NULL, NULL, NULL, NULL);
+}
+
+static void nbd_client_closed(NBDClient *client, void *opaque)
+{
+    nb_fds--;
+    nbd_update_server_fd_handler();
+}
+
+static void nbd_accept(void *opaque)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd;
+
+    fd = accept(server_fd, (struct sockaddr *)&addr, &addr_len);
+    if (fd == -1) {
+        return;
+    }
+    if (nbd_client_new(nbd_export, fd, nbd_client_closed, NULL)) {
+        nb_fds++;
+        nbd_started = true;
+        nbd_update_server_fd_handler();
+    } else {
+        close(fd);
+    }
+}
+
 int main(int argc, char **argv)
 {
     BlockDriverState *bs;
     off_t dev_offset = 0;
-    off_t offset = 0;
     bool readonly = false;
     bool disconnect = false;
     const char *bindto = "0.0.0.0";
     int port = NBD_DEFAULT_PORT;
-    struct sockaddr_in addr;
-    socklen_t addr_len = sizeof(addr);
     off_t fd_size;
     char *device = NULL;
     char *socket = NULL;
@@ -221,14 +255,7 @@ int main(int argc, char **argv)
     int flags = BDRV_O_RDWR;
     int partition = -1;
     int ret;
-    int shared = 1;
-    uint8_t *data;
-    fd_set fds;
-    int *sharing_fds;
     int fd;
-    int i;
-    int nb_fds = 0;
-    int max_fd;
     int persistent = 0;
     uint32_t nbdflags;
 
@@ -431,67 +458,27 @@ int main(int argc, char **argv)
         /* children */
     }
 
-    sharing_fds = g_malloc((shared + 1) * sizeof(int));
-
     if (socket) {
-        sharing_fds[0] = unix_socket_incoming(socket);
+        server_fd = unix_socket_incoming(socket);
     } else {
-        sharing_fds[0] = tcp_socket_incoming(bindto, port);
+        server_fd = tcp_socket_incoming(bindto, port);
     }
 
-    if (sharing_fds[0] == -1)
+    if (server_fd == -1)
         return 1;
-    max_fd = sharing_fds[0];
-    nb_fds++;
 
-    data = qemu_blockalign(bs, NBD_BUFFER_SIZE);
-    if (data == NULL)
-        errx(EXIT_FAILURE, "Cannot allocate data buffer");
+    nbd_export = nbd_export_new(bs, dev_offset, fd_size, readonly);
+    nbd_update_server_fd_handler();
 
+    /* Clients and block I/O completions are all driven from here.  */
     do {
+        qemu_aio_wait();
+    } while (!nbd_started || persistent || nb_fds > 0);
 
-        FD_ZERO(&fds);
-        for (i = 0; i < nb_fds; i++)
-            FD_SET(sharing_fds[i], &fds);
-
-        ret = select(max_fd + 1, &fds, NULL, NULL, NULL);
-        if (ret == -1)
-            break;
-
-        if (FD_ISSET(sharing_fds[0], &fds))
-            ret--;
-        for (i = 1; i < nb_fds && ret; i++) {
-            if (FD_ISSET(sharing_fds[i], &fds)) {
-                if (nbd_trip(bs, sharing_fds[i], fd_size, dev_offset,
-                    &offset, readonly, data, NBD_BUFFER_SIZE) != 0) {
-                    close(sharing_fds[i]);
-                    nb_fds--;
-                    sharing_fds[i] = sharing_fds[nb_fds];
-                    i--;
-                }
-                ret--;
-            }
-        }
-        /* new connection ? */
-        if (FD_ISSET(sharing_fds[0], &fds)) {
-            if (nb_fds < shared + 1) {
-                sharing_fds[nb_fds] = accept(sharing_fds[0],
-                                             (struct sockaddr *)&addr,
-                                             &addr_len);
-                if (sharing_fds[nb_fds] != -1 &&
-                    nbd_negotiate(sharing_fds[nb_fds], fd_size) != -1) {
-                        if (sharing_fds[nb_fds] > max_fd)
-                            max_fd = sharing_fds[nb_fds];
-                        nb_fds++;
-                }
-            }
-        }
-    } while (persistent || nb_fds > 1);
-    qemu_vfree(data);
-
-    close(sharing_fds[0]);
+    qemu_aio_set_fd_handler(server_fd, NULL, NULL, NULL, NULL, NULL);
+    close(server_fd);
+    nbd_export_close(nbd_export);
     bdrv_close(bs);
-    g_free(sharing_fds);
     if (socket)
         unlink(socket);
 
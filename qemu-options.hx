@@ -31,7 +31,11 @@ DEF("machine", HAS_ARG, QEMU_OPTION_machine, \
     "-machine [type=]name[,prop[=value][,...]]\n"
     "                selects emulated machine (-machine ? for list)\n"
     "                property accel=accel1[:accel2[:...]] selects accelerator\n"
-    "                supported accelerators are kvm, xen, tcg (default: tcg)\n",
+    "                supported accelerators are kvm, xen, tcg (default: tcg)\n"
+    "                property mem-hugepage=on|off backs RAM with huge pages\n"
+    "                property mem-prealloc=on|off faults in RAM at startup\n"
+    "                property mem-host-node=node binds RAM to a host node\n"
+    "                property mem-shared=on|off backs RAM with a shared memfd\n",
     QEMU_ARCH_ALL)
 STEXI
 @item -machine [type=]@var{name}[,prop=@var{value}[,...]]
@@ -44,7 +48,19 @@ This is used to enable an accelerator. Depending on the target architecture,
 kvm, xen, or tcg can be available. By default, tcg is used. If there is more
 than one accelerator specified, the next one is used if the previous one fails
 to initialize.
+@item mem-hugepage=on|off
+Align guest RAM to huge page boundaries and ask the host kernel to back it
+with transparent huge pages.
+@item mem-prealloc=on|off
+Fault in all of guest RAM at startup instead of on first access.
+@item mem-host-node=@var{node}
+Bind guest RAM to host NUMA node @var{node}.
+@item mem-shared=on|off
+Back guest RAM with a shared memfd instead of private anonymous memory.
 @end table
+These properties apply to RAM allocated by the board. Memory areas that are
+mapped to an external simulator (TLMu RAM) are backed by that simulator.
+The @code{mem-*} properties are only honoured on Linux hosts.
 ETEXI
 
 HXCOMM Deprecated by -machine
@@ -1480,7 +1496,7 @@ STEXI
 The general form of a character device option is:
 @table @option
 
-@item -chardev @var{backend} ,id=@var{id} [,mux=on|off] [,@var{options}]
+@item -chardev @var{backend} ,id=@var{id} [,mux=on|off] [,coalesce=@var{bytes}] [,@var{options}]
 @findex -chardev
 Backend is one of:
 @option{null},
@@ -1507,6 +1523,13 @@ A character device may be used in multiplexing mode by multiple front-ends.
 The key sequence of @key{Control-a} and @key{c} will rotate the input focus
 between attached front-ends. Specify @option{mux=on} to enable this mode.
 
+@option{coalesce=@var{bytes}} collects output from the front-end in a buffer
+of up to @var{bytes} bytes (at most 65536) instead of passing every write to
+the backend.  The buffer is flushed on a newline, when it is full, 10ms
+after the first buffered byte, and before input is delivered to the
+front-end.  This saves a system call per character for UARTs writing to
+file, pty or socket backends.
+
 Options to each backend are described below.
 
 @item -chardev null ,id=@var{id}
@@ -0,0 +1,136 @@
+/*
+ * Registry of per-subsystem performance counters
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu-common.h"
+#include "qemu-queue.h"
+#include "qemu-timer.h"
+#include "qint.h"
+#include "qlist.h"
+#include "qstring.h"
+#include "qjson.h"
+#include "monitor.h"
+#include "qemu-stats.h"
+
+typedef struct QEMUStatsEntry {
+    const char *name;
+    QEMUStatsFunc *fn;
+    void *opaque;
+    /* Counters returned by the previous query, for the deltas.  */
+    QDict *last;
+    QTAILQ_ENTRY(QEMUStatsEntry) next;
+} QEMUStatsEntry;
+
+static QTAILQ_HEAD(, QEMUStatsEntry) stats_entries =
+    QTAILQ_HEAD_INITIALIZER(stats_entries);
+static int64_t stats_last_ns;
+
+void qemu_stats_register(const char *name, QEMUStatsFunc *fn, void *opaque)
+{
+    QEMUStatsEntry *e;
+
+    e = g_malloc0(sizeof(*e));
+    e->name = name;
+    e->fn = fn;
+    e->opaque = opaque;
+    QTAILQ_INSERT_TAIL(&stats_entries, e, next);
+}
+
+void qemu_stats_put(QDict *dict, const char *prefix, const char *name,
+                    int64_t val)
+{
+    char key[128];
+
+    if (prefix) {
+        snprintf(key, sizeof(key), "%s.%s", prefix, name);
+        name = key;
+    }
+    qdict_put(dict, name, qint_from_int(val));
+}
+
+static QDict *qemu_stats_delta(QDict *cur, QDict *last)
+{
+    const QDictEntry *ent;
+    QDict *delta;
+    int64_t val;
+
+    delta = qdict_new();
+    for (ent = qdict_first(cur); ent; ent = qdict_next(cur, ent)) {
+        val = qint_get_int(qobject_to_qint(qdict_entry_value(ent)));
+        /* Counters that appeared since the last query count from zero.  */
+        if (last && qdict_haskey(last, qdict_entry_key(ent))) {
+            val -= qdict_get_int(last, qdict_entry_key(ent));
+        }
+        qdict_put(delta, qdict_entry_key(ent), qint_from_int(val));
+    }
+    return delta;
+}
+
+static void do_info_stats_print_subsystem(QObject *obj, void *opaque)
+{
+    Monitor *mon = opaque;
+    QDict *qdict = qobject_to_qdict(obj);
+    QDict *counters, *delta;
+    const QDictEntry *ent;
+    const char *key;
+
+    counters = qdict_get_qdict(qdict, "counters");
+    delta = qdict_get_qdict(qdict, "delta");
+    monitor_printf(mon, "%s:\n", qdict_get_str(qdict, "name"));
+    for (ent = qdict_first(counters); ent; ent = qdict_next(counters, ent)) {
+        key = qdict_entry_key(ent);
+        monitor_printf(mon, "  %-32s %" PRId64 " (%+" PRId64 ")\n", key,
+                       qint_get_int(qobject_to_qint(qdict_entry_value(ent))),
+                       qdict_get_int(delta, key));
+    }
+}
+
+void do_info_stats_print(Monitor *mon, const QObject *data)
+{
+    QDict *qdict = qobject_to_qdict(data);
+
+    monitor_printf(mon, "interval: %" PRId64 " ns\n",
+                   qdict_get_int(qdict, "interval_ns"));
+    qlist_iter(qdict_get_qlist(qdict, "subsystems"),
+               do_info_stats_print_subsystem, mon);
+}
+
+/* Snapshot every registered subsystem.  Deltas are relative to the
+   previous query, from whichever monitor it came.  */
+void do_info_stats(Monitor *mon, QObject **ret_data)
+{
+    QEMUStatsEntry *e;
+    QList *subsystems;
+    QDict *counters;
+    QObject *obj;
+    int64_t now;
+
+    now = get_clock();
+    subsystems = qlist_new();
+    QTAILQ_FOREACH(e, &stats_entries, next) {
+        counters = qdict_new();
+        e->fn(counters, e->opaque);
+
+        obj = qobject_from_jsonf("{ 'name': %s }", e->name);
+        qdict_put_obj(qobject_to_qdict(obj), "delta",
+                      QOBJECT(qemu_stats_delta(counters, e->last)));
+        qdict_put(qobject_to_qdict(obj), "counters", counters);
+        qlist_append_obj(subsystems, obj);
+
+        if (e->last) {
+            QDECREF(e->last);
+        }
+        QINCREF(counters);
+        e->last = counters;
+    }
+
+    *ret_data = qobject_from_jsonf("{ 'timestamp_ns': %" PRId64 ", "
+                                   "'interval_ns': %" PRId64 " }",
+                                   now, stats_last_ns ? now - stats_last_ns
+                                                      : (int64_t)0);
+    qdict_put(qobject_to_qdict(*ret_data), "subsystems", subsystems);
+    stats_last_ns = now;
+}
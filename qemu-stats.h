@@ -0,0 +1,27 @@
+/*
+ * Registry of per-subsystem performance counters
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef QEMU_STATS_H
+#define QEMU_STATS_H
+
+#include "qemu-common.h"
+#include "qdict.h"
+
+/* Fill @dict with the current values of a subsystem's counters.  Every
+   value must be an integer; per-device counters use "device.counter"
+   keys.  Called from the monitor, so it should only read counters that
+   are maintained anyway.  */
+typedef void QEMUStatsFunc(QDict *dict, void *opaque);
+
+void qemu_stats_register(const char *name, QEMUStatsFunc *fn, void *opaque);
+void qemu_stats_put(QDict *dict, const char *prefix, const char *name,
+                    int64_t val);
+
+void do_info_stats_print(Monitor *mon, const QObject *data);
+void do_info_stats(Monitor *mon, QObject **ret_data);
+
+#endif
@@ -30,6 +30,10 @@ void qemu_cond_destroy(QemuCond *cond);
 void qemu_cond_signal(QemuCond *cond);
 void qemu_cond_broadcast(QemuCond *cond);
 void qemu_cond_wait(QemuCond *cond, QemuMutex *mutex);
+#ifndef _WIN32
+/* Returns 0 when signalled and ETIMEDOUT once @ms have passed.  */
+int qemu_cond_timedwait(QemuCond *cond, QemuMutex *mutex, unsigned int ms);
+#endif
 
 void qemu_thread_create(QemuThread *thread,
                        void *(*start_routine)(void*),
@@ -37,5 +41,9 @@ void qemu_thread_create(QemuThread *thread,
 void qemu_thread_get_self(QemuThread *thread);
 int qemu_thread_is_self(QemuThread *thread);
 void qemu_thread_exit(void *retval);
+#ifndef _WIN32
+/* Win32 threads are created detached and cannot be joined.  */
+void *qemu_thread_join(QemuThread *thread);
+#endif
 
 #endif
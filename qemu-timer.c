@@ -45,6 +45,7 @@
 #endif
 
 #include "qemu-timer.h"
+#include "qemu-stats.h"
 
 #include "tlm.h"
 
@@ -689,9 +690,21 @@ static const VMStateDescription vmstate_timers = {
     }
 };
 
+static void timer_stats(QDict *dict, void *opaque)
+{
+    qemu_stats_put(dict, NULL, "vm_clock_ns", qemu_get_clock_ns(vm_clock));
+    qemu_stats_put(dict, NULL, "host_clock_ns",
+                   qemu_get_clock_ns(host_clock));
+    if (use_icount) {
+        qemu_stats_put(dict, NULL, "icount", qemu_icount);
+        qemu_stats_put(dict, NULL, "icount_time_shift", icount_time_shift);
+    }
+}
+
 void configure_icount(const char *option)
 {
     vmstate_register(NULL, 0, &vmstate_timers, &timers_state);
+    qemu_stats_register("clock", timer_stats, NULL);
     if (!option)
         return;
 
@@ -1216,6 +1229,22 @@ void quit_timers(void)
     t->stop(t);
 }
 
+/* POSIX timers and interval timers are not inherited by fork(), so a
+   child of a running instance has to arm its own host timer.  */
+int reinit_timer_alarm(void)
+{
+    struct qemu_alarm_timer *t = alarm_timer;
+    int err;
+
+    t->stop(t);
+    err = t->start(t);
+    if (err) {
+        return err;
+    }
+    t->pending = 1;
+    return 0;
+}
+
 int qemu_calculate_timeout(void)
 {
 #ifndef CONFIG_IOTHREAD
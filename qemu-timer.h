@@ -61,6 +61,7 @@ void configure_icount(const char *option);
 int qemu_calculate_timeout(void);
 void init_clocks(void);
 int init_timer_alarm(void);
+int reinit_timer_alarm(void);
 void quit_timers(void);
 
 int64_t cpu_get_ticks(void);
@@ -570,6 +570,43 @@ Example:
 -> { "execute": "migrate_set_downtime", "arguments": { "value": 0.1 } }
 <- { "return": {} }
 
+EQMP
+
+    {
+        .name       = "fork-server",
+        .args_type  = "path:s",
+        .params     = "path",
+        .help       = "stop the VM and fork a clone of it per connection to 'path'",
+        .user_print = monitor_user_noop,
+        .mhandler.cmd_new = do_fork_server,
+    },
+
+SQMP
+fork-server
+-----------
+
+Stop the VM at a quiesced point and listen on a unix socket.  Every
+connection forks a copy of the VM that shares guest RAM with this instance
+copy-on-write.  The copy starts stopped, serves QMP on the connection and
+is resumed with "cont"; it exits on "quit" or when the connection is
+closed.
+
+Block devices must be read-only.  KVM, builds with the I/O thread,
+mem-shared RAM and processes with more than one TLMu instance are not
+supported.  Clones do not receive input from the
+devices they inherit, so tap networking and 9p do not work in them.  Their
+character devices are turned into null devices and their events are only
+sent on their own connection.
+
+Arguments:
+
+- "path": server socket path (json-string)
+
+Example:
+
+-> { "execute": "fork-server", "arguments": { "path": "/tmp/fork.sock" } }
+<- { "return": {} }
+
 EQMP
 
     {
@@ -1291,6 +1328,60 @@ Example:
 
 EQMP
 
+SQMP
+query-stats
+-----------
+
+Show the performance counters of each subsystem.
+
+Every query takes a snapshot of all counters and also returns how much
+each counter changed since the previous query, so that rates can be
+computed without keeping state on the client side.
+
+Return a json-object with the following information:
+
+- "timestamp_ns": host clock at the time of the snapshot (json-int)
+- "interval_ns": time since the previous query, 0 for the first one (json-int)
+- "subsystems": a json-array of json-objects, each containing:
+    - "name": subsystem name, one of "exec", "clock", "block", "net"
+              or "tlm" (json-string)
+    - "counters": json-object mapping counter names to their current
+                  value (json-int)
+    - "delta": json-object with the same keys, holding the change since
+               the previous query (json-int)
+
+Per-device counters are named "<device>.<counter>".  Block devices also
+report request latency histograms as "<op>_latency_lt_<N>us" buckets.
+
+Example:
+
+-> { "execute": "query-stats" }
+<- {
+      "return":{
+         "timestamp_ns":1318847236000000000,
+         "interval_ns":1000345678,
+         "subsystems":[
+            {
+               "name":"exec",
+               "counters":{
+                  "tb_count":5321,
+                  "tb_flush_count":0,
+                  "tlb_fill_count":902377
+               },
+               "delta":{
+                  "tb_count":12,
+                  "tb_flush_count":0,
+                  "tlb_fill_count":3311
+               }
+            }
+         ]
+      }
+   }
+
+Note: the example has been shortened.
+
+EQMP
+
 SQMP
 query-cpus
 ----------
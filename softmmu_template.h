@@ -57,13 +57,18 @@ static inline DATA_TYPE glue(io_read, SUFFIX)(target_phys_addr_t physaddr,
 {
     DATA_TYPE res;
     int index;
+    int icount_credit = -1;
     index = (physaddr >> IO_MEM_SHIFT) & (IO_MEM_NB_ENTRIES - 1);
     physaddr = (physaddr & TARGET_PAGE_MASK) + addr;
     env->mem_io_pc = (unsigned long)retaddr;
     if (index > (IO_MEM_NOTDIRTY >> IO_MEM_SHIFT)
             && !can_do_io(env)
             && !tlm_iodev_is_ram(index)) {
-        cpu_io_recompile(env, retaddr);
+        if (tlm_iodev_is_tlm(index)) {
+            icount_credit = cpu_io_icount_begin(env, retaddr);
+        } else {
+            cpu_io_recompile(env, retaddr);
+        }
     }
 
     env->mem_io_vaddr = addr;
@@ -78,6 +83,9 @@ static inline DATA_TYPE glue(io_read, SUFFIX)(target_phys_addr_t physaddr,
     res |= (uint64_t)io_mem_read[index][2](io_mem_opaque[index], physaddr + 4) << 32;
 #endif
 #endif /* SHIFT > 2 */
+    if (icount_credit >= 0) {
+        cpu_io_icount_end(env, icount_credit);
+    }
     return res;
 }
 
@@ -201,12 +209,17 @@ static inline void glue(io_write, SUFFIX)(target_phys_addr_t physaddr,
                                           void *retaddr)
 {
     int index;
+    int icount_credit = -1;
     index = (physaddr >> IO_MEM_SHIFT) & (IO_MEM_NB_ENTRIES - 1);
     physaddr = (physaddr & TARGET_PAGE_MASK) + addr;
     if (index > (IO_MEM_NOTDIRTY >> IO_MEM_SHIFT)
             && !can_do_io(env)
             && !tlm_iodev_is_ram(index)) {
-        cpu_io_recompile(env, retaddr);
+        if (tlm_iodev_is_tlm(index)) {
+            icount_credit = cpu_io_icount_begin(env, retaddr);
+        } else {
+            cpu_io_recompile(env, retaddr);
+        }
     }
 
     env->mem_io_vaddr = addr;
@@ -222,6 +235,9 @@ static inline void glue(io_write, SUFFIX)(target_phys_addr_t physaddr,
     io_mem_write[index][2](io_mem_opaque[index], physaddr + 4, val >> 32);
 #endif
 #endif /* SHIFT > 2 */
+    if (icount_credit >= 0) {
+        cpu_io_icount_end(env, icount_credit);
+    }
 }
 
 void REGPARM glue(glue(__st, SUFFIX), MMUSUFFIX)(target_ulong addr,
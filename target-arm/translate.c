@@ -3493,6 +3493,28 @@ static int disas_vfp_insn(CPUState * env, DisasContext *s, uint32_t insn)
     return 0;
 }
 
+/* Continue at the TB for the CPU state already stored to env, looking
+   it up from translated code.  */
+static inline void gen_lookup_and_goto_ptr(DisasContext *s)
+{
+    TCGv_ptr ptr;
+    int l;
+
+    if (s->tb->cflags & CF_NOCACHE) {
+        tcg_gen_exit_tb(0);
+        return;
+    }
+    /* live across the brcond */
+    ptr = tcg_temp_local_new_ptr();
+    l = gen_new_label();
+    gen_helper_lookup_tb_ptr(ptr, cpu_env);
+    tcg_gen_brcondi_ptr(TCG_COND_EQ, ptr, 0, l);
+    tcg_gen_goto_ptr(ptr);
+    gen_set_label(l);
+    tcg_temp_free_ptr(ptr);
+    tcg_gen_exit_tb(0);
+}
+
 static inline void gen_goto_tb(DisasContext *s, int n, uint32_t dest)
 {
     TranslationBlock *tb;
@@ -3504,7 +3526,7 @@ static inline void gen_goto_tb(DisasContext *s, int n, uint32_t dest)
         tcg_gen_exit_tb((tcg_target_long)tb + n);
     } else {
         gen_set_pc_im(dest);
-        tcg_gen_exit_tb(0);
+        gen_lookup_and_goto_ptr(s);
     }
 }
 
@@ -9946,9 +9968,14 @@ static inline void gen_intermediate_code_internal(CPUState *env,
         case DISAS_NEXT:
             gen_goto_tb(dc, 1, dc->pc);
             break;
-        default:
         case DISAS_JUMP:
         case DISAS_UPDATE:
+            /* indirect branch or state change: the jump cache is consulted
+               first, and interrupts that became deliverable end the
+               chain there */
+            gen_lookup_and_goto_ptr(dc);
+            break;
+        default:
             /* indicate that the hash table must be used to find the next TB */
             tcg_gen_exit_tb(0);
             break;
@@ -287,4 +287,6 @@ DEF_HELPER_0(rdhwr_ccres, tl)
 DEF_HELPER_1(pmon, void, int)
 DEF_HELPER_0(wait, void)
 
+DEF_HELPER_1(lookup_tb_ptr, ptr, env)
+
 #include "def-helper.h"
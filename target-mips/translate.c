@@ -2677,6 +2677,28 @@ static void gen_trap (DisasContext *ctx, uint32_t opc,
     tcg_temp_free(t1);
 }
 
+/* Continue at the TB for the CPU state already stored to env, looking
+   it up from translated code.  */
+static inline void gen_lookup_and_goto_ptr(DisasContext *ctx)
+{
+    TCGv_ptr ptr;
+    int l;
+
+    if (ctx->tb->cflags & CF_NOCACHE) {
+        tcg_gen_exit_tb(0);
+        return;
+    }
+    /* live across the brcond */
+    ptr = tcg_temp_local_new_ptr();
+    l = gen_new_label();
+    gen_helper_lookup_tb_ptr(ptr, cpu_env);
+    tcg_gen_brcondi_ptr(TCG_COND_EQ, ptr, 0, l);
+    tcg_gen_goto_ptr(ptr);
+    gen_set_label(l);
+    tcg_temp_free_ptr(ptr);
+    tcg_gen_exit_tb(0);
+}
+
 static inline void gen_goto_tb(DisasContext *ctx, int n, target_ulong dest)
 {
     TranslationBlock *tb;
@@ -2692,7 +2714,7 @@ static inline void gen_goto_tb(DisasContext *ctx, int n, target_ulong dest)
             save_cpu_state(ctx, 0);
             gen_helper_0i(raise_exception, EXCP_DEBUG);
         }
-        tcg_gen_exit_tb(0);
+        gen_lookup_and_goto_ptr(ctx);
     }
 }
 
@@ -8133,7 +8155,7 @@ static void handle_delay_slot (CPUState *env, DisasContext *ctx,
                 save_cpu_state(ctx, 0);
                 gen_helper_0i(raise_exception, EXCP_DEBUG);
             }
-            tcg_gen_exit_tb(0);
+            gen_lookup_and_goto_ptr(ctx);
             break;
         default:
             MIPS_DEBUG("unknown branch");
@@ -22,6 +22,10 @@
  * THE SOFTWARE.
  */
 
+#ifdef CONFIG_CPUID_H
+#include <cpuid.h>
+#endif
+
 #ifndef NDEBUG
 static const char * const tcg_target_reg_names[TCG_TARGET_NB_REGS] = {
 #if TCG_TARGET_REG_BITS == 64
@@ -83,6 +87,14 @@ static const int tcg_target_call_oarg_regs[2] = {
 
 static uint8_t *tb_ret_addr;
 
+/* Host has ANDN, probed at run time since it is not part of the
+   x86-64 baseline.  */
+bool have_bmi1;
+
+/* Host has MOVBE, which folds the byte swap of a big-endian guest
+   memory access into the load or store itself.  */
+static bool have_movbe;
+
 static void patch_reloc(uint8_t *code_ptr, int type,
                         tcg_target_long value, tcg_target_long addend)
 {
@@ -166,6 +178,11 @@ static int target_parse_constraint(TCGArgConstraint *ct, const char **pct_str)
             tcg_regset_set32(ct->u.regs, 0, 0xf);
         }
         break;
+    case 'Q':
+        /* registers with a high byte part, %[abcd]h */
+        ct->ct |= TCG_CT_REG;
+        tcg_regset_set32(ct->u.regs, 0, 0xf);
+        break;
     case 'r':
         ct->ct |= TCG_CT_REG;
         if (TCG_TARGET_REG_BITS == 64) {
@@ -228,6 +245,7 @@ static inline int tcg_target_const_match(tcg_target_long val,
 #endif
 
 #define P_EXT		0x100		/* 0x0f opcode prefix */
+#define P_EXT38		0x4000		/* 0x0f 0x38 opcode prefix */
 #define P_DATA16	0x200		/* 0x66 opcode prefix */
 #if TCG_TARGET_REG_BITS == 64
 # define P_ADDR32	0x400		/* 0x67 opcode prefix */
@@ -241,6 +259,7 @@ static inline int tcg_target_const_match(tcg_target_long val,
 # define P_REXB_RM	0
 #endif
 
+#define OPC_ANDN	(0xf2 | P_EXT38)
 #define OPC_ARITH_EvIz	(0x81)
 #define OPC_ARITH_EvIb	(0x83)
 #define OPC_ARITH_GvEv	(0x03)		/* ... plus (ARITH_FOO << 3) */
@@ -258,6 +277,8 @@ static inline int tcg_target_const_match(tcg_target_long val,
 #define OPC_JMP_long	(0xe9)
 #define OPC_JMP_short	(0xeb)
 #define OPC_LEA         (0x8d)
+#define OPC_MOVBE_GyMy	(0xf0 | P_EXT38)
+#define OPC_MOVBE_MyGy	(0xf1 | P_EXT38)
 #define OPC_MOVB_EvGv	(0x88)		/* stores, more or less */
 #define OPC_MOVL_EvGv	(0x89)		/* stores, more or less */
 #define OPC_MOVL_GvEv	(0x8b)		/* loads, more or less */
@@ -379,7 +400,10 @@ static void tcg_out_opc(TCGContext *s, int opc, int r, int rm, int x)
         tcg_out8(s, (uint8_t)(rex | 0x40));
     }
 
-    if (opc & P_EXT) {
+    if (opc & P_EXT38) {
+        tcg_out8(s, 0x0f);
+        tcg_out8(s, 0x38);
+    } else if (opc & P_EXT) {
         tcg_out8(s, 0x0f);
     }
     tcg_out8(s, opc);
@@ -390,7 +414,10 @@ static void tcg_out_opc(TCGContext *s, int opc)
     if (opc & P_DATA16) {
         tcg_out8(s, 0x66);
     }
-    if (opc & P_EXT) {
+    if (opc & P_EXT38) {
+        tcg_out8(s, 0x0f);
+        tcg_out8(s, 0x38);
+    } else if (opc & P_EXT) {
         tcg_out8(s, 0x0f);
     }
     tcg_out8(s, opc);
@@ -407,6 +434,26 @@ static void tcg_out_modrm(TCGContext *s, int opc, int r, int rm)
     tcg_out8(s, 0xc0 | (LOWREGMASK(r) << 3) | LOWREGMASK(rm));
 }
 
+/* Output a register-only VEX encoded instruction with V as the
+   additional source operand.  Only the 0x0f 0x38 map is needed.  */
+static void tcg_out_vex_modrm(TCGContext *s, int opc, int r, int v, int rm)
+{
+    int tmp;
+
+    assert(opc & P_EXT38);
+    tcg_out8(s, 0xc4);
+    tmp = 0x02;                       /* VEX.m-mmmm = 0x0f 0x38 */
+    tmp |= (r & 8 ? 0 : 0x80);        /* VEX.R */
+    tmp |= 0x40;                      /* VEX.X */
+    tmp |= (rm & 8 ? 0 : 0x20);       /* VEX.B */
+    tcg_out8(s, tmp);
+    tmp = (opc & P_REXW ? 0x80 : 0);  /* VEX.W */
+    tmp |= (~v & 15) << 3;            /* VEX.vvvv, VEX.L = 0, VEX.pp = 0 */
+    tcg_out8(s, tmp);
+    tcg_out8(s, opc);
+    tcg_out8(s, 0xc0 | (LOWREGMASK(r) << 3) | LOWREGMASK(rm));
+}
+
 /* Output an opcode with a full "rm + (index<<shift) + offset" address mode.
    We handle either RM and INDEX missing with a negative value.  In 64-bit
    mode for absolute addresses, ~RM is the size of the immediate operand
@@ -987,7 +1034,8 @@ static void *qemu_st_helpers[4] = {
 
    Outputs:
    LABEL_PTRS is filled with 1 (32-bit addresses) or 2 (64-bit addresses)
-   positions of the displacements of forward jumps to the TLB miss case.
+   positions of the 32-bit displacements of forward jumps to the TLB miss
+   case, which is emitted out of line at the end of the TB.
 
    First argument register is loaded with the low part of the address.
    In the TLB hit case, it has been adjusted as indicated by the TLB
@@ -1032,19 +1080,19 @@ static inline void tcg_out_tlb_load(TCGContext *s, int addrlo_idx,
 
     tcg_out_mov(s, type, r0, addrlo);
 
-    /* jne label1 */
-    tcg_out8(s, OPC_JCC_short + JCC_JNE);
+    /* jne slow_path */
+    tcg_out_opc(s, OPC_JCC_long + JCC_JNE, 0, 0, 0);
     label_ptr[0] = s->code_ptr;
-    s->code_ptr++;
+    s->code_ptr += 4;
 
     if (TARGET_LONG_BITS > TCG_TARGET_REG_BITS) {
         /* cmp 4(r1), addrhi */
         tcg_out_modrm_offset(s, OPC_CMP_GvEv, args[addrlo_idx+1], r1, 4);
 
-        /* jne label1 */
-        tcg_out8(s, OPC_JCC_short + JCC_JNE);
+        /* jne slow_path */
+        tcg_out_opc(s, OPC_JCC_long + JCC_JNE, 0, 0, 0);
         label_ptr[1] = s->code_ptr;
-        s->code_ptr++;
+        s->code_ptr += 4;
     }
 
     /* TLB Hit.  */
@@ -1053,6 +1101,42 @@ static inline void tcg_out_tlb_load(TCGContext *s, int addrlo_idx,
     tcg_out_modrm_offset(s, OPC_ADD_GvEv + P_REXW, r0, r1,
                          offsetof(CPUTLBEntry, addend) - which);
 }
+
+/* Record the TLB miss case of a qemu_ld/st.  It is emitted at the end of
+   the TB by tcg_out_qemu_ldst_slow_path and jumps back to RADDR, so that
+   only the compare and branch stay inline.  */
+static void add_qemu_ldst_label(TCGContext *s, int is_ld, int opc,
+                                int datalo, int datahi,
+                                int addrlo, int addrhi, int mem_index,
+                                uint8_t *raddr, uint8_t **label_ptr)
+{
+    TCGLabelQemuLdst *l;
+
+    if (s->nb_qemu_ldst_labels >= TCG_MAX_QEMU_LDST) {
+        tcg_abort();
+    }
+    l = &s->qemu_ldst_labels[s->nb_qemu_ldst_labels++];
+    l->is_ld = is_ld;
+    l->opc = opc;
+    l->datalo_reg = datalo;
+    l->datahi_reg = datahi;
+    l->addrlo_reg = addrlo;
+    l->addrhi_reg = addrhi;
+    l->mem_index = mem_index;
+    l->raddr = raddr;
+    l->label_ptr[0] = label_ptr[0];
+    if (TARGET_LONG_BITS > TCG_TARGET_REG_BITS) {
+        l->label_ptr[1] = label_ptr[1];
+    }
+}
+
+static void tcg_out_patch_miss(TCGContext *s, TCGLabelQemuLdst *l)
+{
+    *(int32_t *)l->label_ptr[0] = s->code_ptr - l->label_ptr[0] - 4;
+    if (TARGET_LONG_BITS > TCG_TARGET_REG_BITS) {
+        *(int32_t *)l->label_ptr[1] = s->code_ptr - l->label_ptr[1] - 4;
+    }
+}
 #endif
 
 static void tcg_out_qemu_ld_direct(TCGContext *s, int datalo, int datahi,
@@ -1077,7 +1161,11 @@ static void tcg_out_qemu_ld_direct(TCGContext *s, int datalo, int datahi,
         }
         break;
     case 1 | 4:
-        if (bswap) {
+        if (bswap && have_movbe) {
+            tcg_out_modrm_offset(s, OPC_MOVBE_GyMy + P_DATA16,
+                                 datalo, base, ofs);
+            tcg_out_modrm(s, OPC_MOVSWL + P_REXW, datalo, datalo);
+        } else if (bswap) {
             tcg_out_modrm_offset(s, OPC_MOVZWL, datalo, base, ofs);
             tcg_out_rolw_8(s, datalo);
             tcg_out_modrm(s, OPC_MOVSWL + P_REXW, datalo, datalo);
@@ -1086,6 +1174,10 @@ static void tcg_out_qemu_ld_direct(TCGContext *s, int datalo, int datahi,
         }
         break;
     case 2:
+        if (bswap && have_movbe) {
+            tcg_out_modrm_offset(s, OPC_MOVBE_GyMy, datalo, base, ofs);
+            break;
+        }
         tcg_out_ld(s, TCG_TYPE_I32, datalo, base, ofs);
         if (bswap) {
             tcg_out_bswap32(s, datalo);
@@ -1093,7 +1185,10 @@ static void tcg_out_qemu_ld_direct(TCGContext *s, int datalo, int datahi,
         break;
 #if TCG_TARGET_REG_BITS == 64
     case 2 | 4:
-        if (bswap) {
+        if (bswap && have_movbe) {
+            tcg_out_modrm_offset(s, OPC_MOVBE_GyMy, datalo, base, ofs);
+            tcg_out_ext32s(s, datalo, datalo);
+        } else if (bswap) {
             tcg_out_ld(s, TCG_TYPE_I32, datalo, base, ofs);
             tcg_out_bswap32(s, datalo);
             tcg_out_ext32s(s, datalo, datalo);
@@ -1104,24 +1199,34 @@ static void tcg_out_qemu_ld_direct(TCGContext *s, int datalo, int datahi,
 #endif
     case 3:
         if (TCG_TARGET_REG_BITS == 64) {
+            if (bswap && have_movbe) {
+                tcg_out_modrm_offset(s, OPC_MOVBE_GyMy + P_REXW,
+                                     datalo, base, ofs);
+                break;
+            }
             tcg_out_ld(s, TCG_TYPE_I64, datalo, base, ofs);
             if (bswap) {
                 tcg_out_bswap64(s, datalo);
             }
         } else {
+            int ldop = OPC_MOVL_GvEv;
+
             if (bswap) {
                 int t = datalo;
                 datalo = datahi;
                 datahi = t;
+                if (have_movbe) {
+                    ldop = OPC_MOVBE_GyMy;
+                }
             }
             if (base != datalo) {
-                tcg_out_ld(s, TCG_TYPE_I32, datalo, base, ofs);
-                tcg_out_ld(s, TCG_TYPE_I32, datahi, base, ofs + 4);
+                tcg_out_modrm_offset(s, ldop, datalo, base, ofs);
+                tcg_out_modrm_offset(s, ldop, datahi, base, ofs + 4);
             } else {
-                tcg_out_ld(s, TCG_TYPE_I32, datahi, base, ofs + 4);
-                tcg_out_ld(s, TCG_TYPE_I32, datalo, base, ofs);
+                tcg_out_modrm_offset(s, ldop, datahi, base, ofs + 4);
+                tcg_out_modrm_offset(s, ldop, datalo, base, ofs);
             }
-            if (bswap) {
+            if (bswap && !have_movbe) {
                 tcg_out_bswap32(s, datalo);
                 tcg_out_bswap32(s, datahi);
             }
@@ -1141,8 +1246,8 @@ static void tcg_out_qemu_ld(TCGContext *s, const TCGArg *args,
     int data_reg, data_reg2 = 0;
     int addrlo_idx;
 #if defined(CONFIG_SOFTMMU)
-    int mem_index, s_bits, arg_idx;
-    uint8_t *label_ptr[3];
+    int mem_index, s_bits;
+    uint8_t *label_ptr[2];
 #endif
 
     data_reg = args[0];
@@ -1163,69 +1268,10 @@ static void tcg_out_qemu_ld(TCGContext *s, const TCGArg *args,
     tcg_out_qemu_ld_direct(s, data_reg, data_reg2,
                            tcg_target_call_iarg_regs[0], 0, opc);
 
-    /* jmp label2 */
-    tcg_out8(s, OPC_JMP_short);
-    label_ptr[2] = s->code_ptr;
-    s->code_ptr++;
-
-    /* TLB Miss.  */
-
-    /* label1: */
-    *label_ptr[0] = s->code_ptr - label_ptr[0] - 1;
-    if (TARGET_LONG_BITS > TCG_TARGET_REG_BITS) {
-        *label_ptr[1] = s->code_ptr - label_ptr[1] - 1;
-    }
-
-    /* XXX: move that code at the end of the TB */
-    /* The first argument is already loaded with addrlo.  */
-    arg_idx = 1;
-    if (TCG_TARGET_REG_BITS == 32 && TARGET_LONG_BITS == 64) {
-        tcg_out_mov(s, TCG_TYPE_I32, tcg_target_call_iarg_regs[arg_idx++],
-                    args[addrlo_idx + 1]);
-    }
-    tcg_out_movi(s, TCG_TYPE_I32, tcg_target_call_iarg_regs[arg_idx],
-                 mem_index);
-    tcg_out_calli(s, (tcg_target_long)qemu_ld_helpers[s_bits]);
-
-    switch(opc) {
-    case 0 | 4:
-        tcg_out_ext8s(s, data_reg, TCG_REG_EAX, P_REXW);
-        break;
-    case 1 | 4:
-        tcg_out_ext16s(s, data_reg, TCG_REG_EAX, P_REXW);
-        break;
-    case 0:
-        tcg_out_ext8u(s, data_reg, TCG_REG_EAX);
-        break;
-    case 1:
-        tcg_out_ext16u(s, data_reg, TCG_REG_EAX);
-        break;
-    case 2:
-        tcg_out_mov(s, TCG_TYPE_I32, data_reg, TCG_REG_EAX);
-        break;
-#if TCG_TARGET_REG_BITS == 64
-    case 2 | 4:
-        tcg_out_ext32s(s, data_reg, TCG_REG_EAX);
-        break;
-#endif
-    case 3:
-        if (TCG_TARGET_REG_BITS == 64) {
-            tcg_out_mov(s, TCG_TYPE_I64, data_reg, TCG_REG_RAX);
-        } else if (data_reg == TCG_REG_EDX) {
-            /* xchg %edx, %eax */
-            tcg_out_opc(s, OPC_XCHG_ax_r32 + TCG_REG_EDX, 0, 0, 0);
-            tcg_out_mov(s, TCG_TYPE_I32, data_reg2, TCG_REG_EAX);
-        } else {
-            tcg_out_mov(s, TCG_TYPE_I32, data_reg, TCG_REG_EAX);
-            tcg_out_mov(s, TCG_TYPE_I32, data_reg2, TCG_REG_EDX);
-        }
-        break;
-    default:
-        tcg_abort();
-    }
-
-    /* label2: */
-    *label_ptr[2] = s->code_ptr - label_ptr[2] - 1;
+    /* TLB Miss: out of line, returning here.  */
+    add_qemu_ldst_label(s, 1, opc, data_reg, data_reg2, args[addrlo_idx],
+                        args[addrlo_idx + 1], mem_index, s->code_ptr,
+                        label_ptr);
 #else
     {
         int32_t offset = GUEST_BASE;
@@ -1269,6 +1315,11 @@ static void tcg_out_qemu_st_direct(TCGContext *s, int datalo, int datahi,
         tcg_out_modrm_offset(s, OPC_MOVB_EvGv + P_REXB_R, datalo, base, ofs);
         break;
     case 1:
+        if (bswap && have_movbe) {
+            tcg_out_modrm_offset(s, OPC_MOVBE_MyGy + P_DATA16,
+                                 datalo, base, ofs);
+            break;
+        }
         if (bswap) {
             tcg_out_mov(s, TCG_TYPE_I32, scratch, datalo);
             tcg_out_rolw_8(s, scratch);
@@ -1277,6 +1328,10 @@ static void tcg_out_qemu_st_direct(TCGContext *s, int datalo, int datahi,
         tcg_out_modrm_offset(s, OPC_MOVL_EvGv + P_DATA16, datalo, base, ofs);
         break;
     case 2:
+        if (bswap && have_movbe) {
+            tcg_out_modrm_offset(s, OPC_MOVBE_MyGy, datalo, base, ofs);
+            break;
+        }
         if (bswap) {
             tcg_out_mov(s, TCG_TYPE_I32, scratch, datalo);
             tcg_out_bswap32(s, scratch);
@@ -1286,12 +1341,20 @@ static void tcg_out_qemu_st_direct(TCGContext *s, int datalo, int datahi,
         break;
     case 3:
         if (TCG_TARGET_REG_BITS == 64) {
+            if (bswap && have_movbe) {
+                tcg_out_modrm_offset(s, OPC_MOVBE_MyGy + P_REXW,
+                                     datalo, base, ofs);
+                break;
+            }
             if (bswap) {
                 tcg_out_mov(s, TCG_TYPE_I64, scratch, datalo);
                 tcg_out_bswap64(s, scratch);
                 datalo = scratch;
             }
             tcg_out_st(s, TCG_TYPE_I64, datalo, base, ofs);
+        } else if (bswap && have_movbe) {
+            tcg_out_modrm_offset(s, OPC_MOVBE_MyGy, datahi, base, ofs);
+            tcg_out_modrm_offset(s, OPC_MOVBE_MyGy, datalo, base, ofs + 4);
         } else if (bswap) {
             tcg_out_mov(s, TCG_TYPE_I32, scratch, datahi);
             tcg_out_bswap32(s, scratch);
@@ -1316,8 +1379,7 @@ static void tcg_out_qemu_st(TCGContext *s, const TCGArg *args,
     int addrlo_idx;
 #if defined(CONFIG_SOFTMMU)
     int mem_index, s_bits;
-    int stack_adjust;
-    uint8_t *label_ptr[3];
+    uint8_t *label_ptr[2];
 #endif
 
     data_reg = args[0];
@@ -1338,20 +1400,107 @@ static void tcg_out_qemu_st(TCGContext *s, const TCGArg *args,
     tcg_out_qemu_st_direct(s, data_reg, data_reg2,
                            tcg_target_call_iarg_regs[0], 0, opc);
 
-    /* jmp label2 */
-    tcg_out8(s, OPC_JMP_short);
-    label_ptr[2] = s->code_ptr;
-    s->code_ptr++;
+    /* TLB Miss: out of line, returning here.  */
+    add_qemu_ldst_label(s, 0, opc, data_reg, data_reg2, args[addrlo_idx],
+                        args[addrlo_idx + 1], mem_index, s->code_ptr,
+                        label_ptr);
+#else
+    {
+        int32_t offset = GUEST_BASE;
+        int base = args[addrlo_idx];
+
+        if (TCG_TARGET_REG_BITS == 64) {
+            /* ??? We assume all operations have left us with register
+               contents that are zero extended.  So far this appears to
+               be true.  If we want to enforce this, we can either do
+               an explicit zero-extension here, or (if GUEST_BASE == 0)
+               use the ADDR32 prefix.  For now, do nothing.  */
+
+            if (offset != GUEST_BASE) {
+                tcg_out_movi(s, TCG_TYPE_I64, TCG_REG_RDI, GUEST_BASE);
+                tgen_arithr(s, ARITH_ADD + P_REXW, TCG_REG_RDI, base);
+                base = TCG_REG_RDI, offset = 0;
+            }
+        }
 
-    /* TLB Miss.  */
+        tcg_out_qemu_st_direct(s, data_reg, data_reg2, base, offset, opc);
+    }
+#endif
+}
 
-    /* label1: */
-    *label_ptr[0] = s->code_ptr - label_ptr[0] - 1;
-    if (TARGET_LONG_BITS > TCG_TARGET_REG_BITS) {
-        *label_ptr[1] = s->code_ptr - label_ptr[1] - 1;
+#if defined(CONFIG_SOFTMMU)
+static void tcg_out_qemu_ld_slow_path(TCGContext *s, TCGLabelQemuLdst *l)
+{
+    int opc = l->opc;
+    int s_bits = opc & 3;
+    int data_reg = l->datalo_reg;
+    int data_reg2 = l->datahi_reg;
+    int mem_index = l->mem_index;
+    int arg_idx;
+
+    tcg_out_patch_miss(s, l);
+
+    /* The first argument is already loaded with addrlo.  */
+    arg_idx = 1;
+    if (TCG_TARGET_REG_BITS == 32 && TARGET_LONG_BITS == 64) {
+        tcg_out_mov(s, TCG_TYPE_I32, tcg_target_call_iarg_regs[arg_idx++],
+                    l->addrhi_reg);
+    }
+    tcg_out_movi(s, TCG_TYPE_I32, tcg_target_call_iarg_regs[arg_idx],
+                 mem_index);
+    tcg_out_calli(s, (tcg_target_long)qemu_ld_helpers[s_bits]);
+
+    switch(opc) {
+    case 0 | 4:
+        tcg_out_ext8s(s, data_reg, TCG_REG_EAX, P_REXW);
+        break;
+    case 1 | 4:
+        tcg_out_ext16s(s, data_reg, TCG_REG_EAX, P_REXW);
+        break;
+    case 0:
+        tcg_out_ext8u(s, data_reg, TCG_REG_EAX);
+        break;
+    case 1:
+        tcg_out_ext16u(s, data_reg, TCG_REG_EAX);
+        break;
+    case 2:
+        tcg_out_mov(s, TCG_TYPE_I32, data_reg, TCG_REG_EAX);
+        break;
+#if TCG_TARGET_REG_BITS == 64
+    case 2 | 4:
+        tcg_out_ext32s(s, data_reg, TCG_REG_EAX);
+        break;
+#endif
+    case 3:
+        if (TCG_TARGET_REG_BITS == 64) {
+            tcg_out_mov(s, TCG_TYPE_I64, data_reg, TCG_REG_RAX);
+        } else if (data_reg == TCG_REG_EDX) {
+            /* xchg %edx, %eax */
+            tcg_out_opc(s, OPC_XCHG_ax_r32 + TCG_REG_EDX, 0, 0, 0);
+            tcg_out_mov(s, TCG_TYPE_I32, data_reg2, TCG_REG_EAX);
+        } else {
+            tcg_out_mov(s, TCG_TYPE_I32, data_reg, TCG_REG_EAX);
+            tcg_out_mov(s, TCG_TYPE_I32, data_reg2, TCG_REG_EDX);
+        }
+        break;
+    default:
+        tcg_abort();
     }
 
-    /* XXX: move that code at the end of the TB */
+    tcg_out_jmp(s, (tcg_target_long)l->raddr);
+}
+
+static void tcg_out_qemu_st_slow_path(TCGContext *s, TCGLabelQemuLdst *l)
+{
+    int opc = l->opc;
+    int s_bits = opc;
+    int data_reg = l->datalo_reg;
+    int data_reg2 = l->datahi_reg;
+    int mem_index = l->mem_index;
+    int stack_adjust;
+
+    tcg_out_patch_miss(s, l);
+
     if (TCG_TARGET_REG_BITS == 64) {
         tcg_out_mov(s, (opc == 3 ? TCG_TYPE_I64 : TCG_TYPE_I32),
                     TCG_REG_RSI, data_reg);
@@ -1369,13 +1518,13 @@ static void tcg_out_qemu_st(TCGContext *s, const TCGArg *args,
         }
     } else {
         if (opc == 3) {
-            tcg_out_mov(s, TCG_TYPE_I32, TCG_REG_EDX, args[addrlo_idx + 1]);
+            tcg_out_mov(s, TCG_TYPE_I32, TCG_REG_EDX, l->addrhi_reg);
             tcg_out_pushi(s, mem_index);
             tcg_out_push(s, data_reg2);
             tcg_out_push(s, data_reg);
             stack_adjust = 12;
         } else {
-            tcg_out_mov(s, TCG_TYPE_I32, TCG_REG_EDX, args[addrlo_idx + 1]);
+            tcg_out_mov(s, TCG_TYPE_I32, TCG_REG_EDX, l->addrhi_reg);
             switch(opc) {
             case 0:
                 tcg_out_ext8u(s, TCG_REG_ECX, data_reg);
@@ -1401,31 +1550,21 @@ static void tcg_out_qemu_st(TCGContext *s, const TCGArg *args,
         tcg_out_addi(s, TCG_REG_CALL_STACK, stack_adjust);
     }
 
-    /* label2: */
-    *label_ptr[2] = s->code_ptr - label_ptr[2] - 1;
-#else
-    {
-        int32_t offset = GUEST_BASE;
-        int base = args[addrlo_idx];
-
-        if (TCG_TARGET_REG_BITS == 64) {
-            /* ??? We assume all operations have left us with register
-               contents that are zero extended.  So far this appears to
-               be true.  If we want to enforce this, we can either do
-               an explicit zero-extension here, or (if GUEST_BASE == 0)
-               use the ADDR32 prefix.  For now, do nothing.  */
-
-            if (offset != GUEST_BASE) {
-                tcg_out_movi(s, TCG_TYPE_I64, TCG_REG_RDI, GUEST_BASE);
-                tgen_arithr(s, ARITH_ADD + P_REXW, TCG_REG_RDI, base);
-                base = TCG_REG_RDI, offset = 0;
-            }
-        }
+    tcg_out_jmp(s, (tcg_target_long)l->raddr);
+}
 
-        tcg_out_qemu_st_direct(s, data_reg, data_reg2, base, offset, opc);
+/* Emit the TLB miss case of a qemu_ld/st.  Register contents are those
+   at the jne in the inline part, so the first argument register still
+   holds the guest address.  */
+static void tcg_out_qemu_ldst_slow_path(TCGContext *s, TCGLabelQemuLdst *l)
+{
+    if (l->is_ld) {
+        tcg_out_qemu_ld_slow_path(s, l);
+    } else {
+        tcg_out_qemu_st_slow_path(s, l);
     }
-#endif
 }
+#endif
 
 static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
                               const TCGArg *args, const int *const_args)
@@ -1626,6 +1765,27 @@ static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
         tcg_out_modrm(s, OPC_GRP3_Ev + rexw, EXT3_NOT, args[0]);
         break;
 
+    OP_32_64(andc):
+        /* andn computes ~vvvv & rm */
+        tcg_out_vex_modrm(s, OPC_ANDN + rexw, args[0], args[2], args[1]);
+        break;
+
+    OP_32_64(deposit):
+        if (args[3] == 0 && args[4] == 8) {
+            /* load bits 0..7 */
+            tcg_out_modrm(s, OPC_MOVB_EvGv | P_REXB_R | P_REXB_RM,
+                          args[2], args[0]);
+        } else if (args[3] == 8 && args[4] == 8) {
+            /* load bits 8..15 */
+            tcg_out_modrm(s, OPC_MOVB_EvGv, args[2], args[0] + 4);
+        } else if (args[3] == 0 && args[4] == 16) {
+            /* load bits 0..15 */
+            tcg_out_modrm(s, OPC_MOVL_EvGv | P_DATA16, args[2], args[0]);
+        } else {
+            tcg_abort();
+        }
+        break;
+
     OP_32_64(ext8s):
         tcg_out_ext8s(s, args[0], args[1], rexw);
         break;
@@ -1800,6 +1960,9 @@ static const TCGTargetOpDef x86_op_defs[] = {
 
     { INDEX_op_setcond_i32, { "q", "r", "ri" } },
 
+    { INDEX_op_andc_i32, { "r", "r", "r" } },
+    { INDEX_op_deposit_i32, { "Q", "0", "Q" } },
+
 #if TCG_TARGET_REG_BITS == 32
     { INDEX_op_mulu2_i32, { "a", "d", "a", "r" } },
     { INDEX_op_add2_i32, { "r", "r", "0", "1", "ri", "ri" } },
@@ -1851,6 +2014,9 @@ static const TCGTargetOpDef x86_op_defs[] = {
     { INDEX_op_ext8u_i64, { "r", "r" } },
     { INDEX_op_ext16u_i64, { "r", "r" } },
     { INDEX_op_ext32u_i64, { "r", "r" } },
+
+    { INDEX_op_andc_i64, { "r", "r", "r" } },
+    { INDEX_op_deposit_i64, { "Q", "0", "Q" } },
 #endif
 
 #if TCG_TARGET_REG_BITS == 64
@@ -1955,6 +2121,22 @@ static void tcg_target_qemu_prologue(TCGContext *s)
 
 static void tcg_target_init(TCGContext *s)
 {
+#ifdef CONFIG_CPUID_H
+    unsigned a, b, c, d;
+    int max = __get_cpuid_max(0, 0);
+
+    if (max >= 1) {
+        /* MOVBE is leaf 1, %ecx bit 22 */
+        __cpuid(1, a, b, c, d);
+        have_movbe = (c & (1 << 22)) != 0;
+    }
+    if (max >= 7) {
+        /* BMI1 is leaf 7, %ebx bit 3 */
+        __cpuid_count(7, 0, a, b, c, d);
+        have_bmi1 = (b & (1 << 3)) != 0;
+    }
+#endif
+
 #if !defined(CONFIG_USER_ONLY)
     /* fail safe */
     if ((1 << CPU_TLB_ENTRY_BITS) != sizeof(CPUTLBEntry))
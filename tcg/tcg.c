@@ -238,6 +238,12 @@ void tcg_context_init(TCGContext *s)
         sorted_args += n;
         args_ct += n;
     }
+
+#ifdef USE_QEMU_LDST_LABELS
+    /* too big for the TB pool, which only handles chunk sized requests */
+    s->qemu_ldst_labels = g_malloc(sizeof(TCGLabelQemuLdst) *
+                                   TCG_MAX_QEMU_LDST);
+#endif
     
     tcg_target_init(s);
 }
@@ -269,6 +275,9 @@ void tcg_func_start(TCGContext *s)
         s->first_free_temp[i] = -1;
     s->labels = tcg_malloc(sizeof(TCGLabel) * TCG_MAX_LABELS);
     s->nb_labels = 0;
+#ifdef USE_QEMU_LDST_LABELS
+    s->nb_qemu_ldst_labels = 0;
+#endif
     s->current_frame_offset = s->frame_start;
 
     gen_opc_ptr = gen_opc_buf;
@@ -1536,6 +1545,27 @@ static void temp_save(TCGContext *s, int temp, TCGRegSet allocated_regs)
     }
 }
 
+/* store a temporary to memory if its register copy is newer, but keep
+   the register.  Constants are saved as with temp_save. */
+static void temp_sync(TCGContext *s, int temp, TCGRegSet allocated_regs)
+{
+    TCGTemp *ts;
+
+    ts = &s->temps[temp];
+    if (!ts->fixed_reg) {
+        if (ts->val_type == TEMP_VAL_REG) {
+            if (!ts->mem_coherent) {
+                if (!ts->mem_allocated)
+                    temp_allocate_frame(s, temp);
+                tcg_out_st(s, ts->type, ts->reg, ts->mem_reg, ts->mem_offset);
+                ts->mem_coherent = 1;
+            }
+        } else {
+            temp_save(s, temp, allocated_regs);
+        }
+    }
+}
+
 /* save globals to their cannonical location and assume they can be
    modified be the following code. 'allocated_regs' is used in case a
    temporary registers needs to be allocated to store a constant. */
@@ -1548,6 +1578,18 @@ static void save_globals(TCGContext *s, TCGRegSet allocated_regs)
     }
 }
 
+/* store globals whose register copy is newer than memory, but keep
+   them in registers.  Used where the following code may read globals
+   from memory but does not modify them. */
+static void sync_globals(TCGContext *s, TCGRegSet allocated_regs)
+{
+    int i;
+
+    for(i = 0; i < s->nb_globals; i++) {
+        temp_sync(s, i, allocated_regs);
+    }
+}
+
 /* at the end of a basic block, we assume all temporaries are dead and
    all globals are stored at their canonical location. */
 static void tcg_reg_alloc_bb_end(TCGContext *s, TCGRegSet allocated_regs)
@@ -1570,6 +1612,31 @@ static void tcg_reg_alloc_bb_end(TCGContext *s, TCGRegSet allocated_regs)
     save_globals(s, allocated_regs);
 }
 
+/* at a conditional branch, memory must be up to date for the branch
+   target, which starts from the canonical locations like any label.
+   The fallthrough path keeps the register copies of globals and local
+   temps since they now agree with memory, so that guest registers are
+   not reloaded after every internal branch. */
+static void tcg_reg_alloc_cond_branch(TCGContext *s, TCGRegSet allocated_regs)
+{
+    TCGTemp *ts;
+    int i;
+
+    for(i = s->nb_globals; i < s->nb_temps; i++) {
+        ts = &s->temps[i];
+        if (ts->temp_local) {
+            temp_sync(s, i, allocated_regs);
+        } else {
+            if (ts->val_type == TEMP_VAL_REG) {
+                s->reg_to_temp[ts->reg] = -1;
+            }
+            ts->val_type = TEMP_VAL_DEAD;
+        }
+    }
+
+    sync_globals(s, allocated_regs);
+}
+
 #define IS_DEAD_ARG(n) ((dead_args >> (n)) & 1)
 
 static void tcg_reg_alloc_movi(TCGContext *s, const TCGArg *args)
@@ -1735,7 +1802,9 @@ static void tcg_reg_alloc_op(TCGContext *s,
     iarg_end: ;
     }
     
-    if (def->flags & TCG_OPF_BB_END) {
+    if (def->flags & TCG_OPF_COND_BRANCH) {
+        tcg_reg_alloc_cond_branch(s, allocated_regs);
+    } else if (def->flags & TCG_OPF_BB_END) {
         tcg_reg_alloc_bb_end(s, allocated_regs);
     } else {
         /* mark dead temporaries and free the associated registers */
@@ -1969,8 +2038,12 @@ static int tcg_reg_alloc_call(TCGContext *s, const TCGOpDef *def,
     }
     
     /* store globals and free associated registers (we assume the call
-       can modify any global. */
-    if (!(flags & TCG_CALL_CONST)) {
+       can modify any global, unless it is declared not to. */
+    if (flags & TCG_CALL_CONST) {
+        /* nothing to do */
+    } else if (flags & TCG_CALL_NO_WRITE_GLOBALS) {
+        sync_globals(s, allocated_regs);
+    } else {
         save_globals(s, allocated_regs);
     }
 
@@ -2028,6 +2101,9 @@ static inline int tcg_gen_code_common(TCGContext *s, uint8_t *gen_code_buf,
     const TCGOpDef *def;
     unsigned int dead_args;
     const TCGArg *args;
+#ifdef USE_QEMU_LDST_LABELS
+    int i, nb_ldst = 0;
+#endif
 
 #ifdef DEBUG_DISAS
     if (unlikely(qemu_loglevel_mask(CPU_LOG_TB_OP))) {
@@ -2134,6 +2210,11 @@ static inline int tcg_gen_code_common(TCGContext *s, uint8_t *gen_code_buf,
                some common argument patterns */
             dead_args = s->op_dead_args[op_index];
             tcg_reg_alloc_op(s, def, opc, args, dead_args);
+#ifdef USE_QEMU_LDST_LABELS
+            for (; nb_ldst < s->nb_qemu_ldst_labels; nb_ldst++) {
+                s->qemu_ldst_labels[nb_ldst].op_index = op_index;
+            }
+#endif
             break;
         }
         args += def->nb_args;
@@ -2147,6 +2228,17 @@ static inline int tcg_gen_code_common(TCGContext *s, uint8_t *gen_code_buf,
 #endif
     }
  the_end:
+#ifdef USE_QEMU_LDST_LABELS
+    /* TLB miss paths go after the body of the TB.  A host pc inside one
+       of them (e.g. the return address of the helper call) belongs to
+       the qemu_ld/st op that branched there.  */
+    for (i = 0; i < s->nb_qemu_ldst_labels; i++) {
+        tcg_out_qemu_ldst_slow_path(s, &s->qemu_ldst_labels[i]);
+        if (search_pc >= 0 && search_pc < s->code_ptr - gen_code_buf) {
+            return s->qemu_ldst_labels[i].op_index;
+        }
+    }
+#endif
     return -1;
 }
 
@@ -25,6 +25,13 @@
 #include "tcg-target.h"
 #include "tcg-runtime.h"
 
+#ifndef TCG_TARGET_deposit_i32_valid
+#define TCG_TARGET_deposit_i32_valid(ofs, len) 1
+#endif
+#ifndef TCG_TARGET_deposit_i64_valid
+#define TCG_TARGET_deposit_i64_valid(ofs, len) 1
+#endif
+
 #if TCG_TARGET_REG_BITS == 32
 typedef int32_t tcg_target_long;
 typedef uint32_t tcg_target_ulong;
@@ -128,6 +135,28 @@ typedef struct TCGPool {
 
 #define TCG_MAX_TEMPS 512
 
+#if defined(TCG_TARGET_HAS_LDST_LABELS) && defined(CONFIG_SOFTMMU)
+#define USE_QEMU_LDST_LABELS
+
+/* at most one per op, see OPC_BUF_SIZE */
+#define TCG_MAX_QEMU_LDST 640
+
+/* TLB miss case of a qemu_ld/st, emitted by the backend after the last op
+   of the TB.  It ends with a jump back to RADDR.  */
+typedef struct TCGLabelQemuLdst {
+    int is_ld;
+    int opc;
+    int datalo_reg;
+    int datahi_reg;
+    int addrlo_reg;
+    int addrhi_reg;
+    int mem_index;
+    int op_index;           /* op owning the slow path, for search_pc */
+    uint8_t *raddr;         /* return address in the inline code */
+    uint8_t *label_ptr[2];  /* displacements of the branches to patch */
+} TCGLabelQemuLdst;
+#endif
+
 /* when the size of the arguments of a called function is smaller than
    this value, they are statically allocated in the TB stack frame */
 #define TCG_STATIC_CALL_ARGS_SIZE 128
@@ -248,6 +277,10 @@ typedef int TCGv_i64;
    global variables. Hence a call to such a function does not
    save TCG global variables back to their canonical location. */
 #define TCG_CALL_CONST          0x0020
+/* A function that may read TCG global variables (or raise an
+   exception) but never modifies them.  Globals are written back
+   before the call but their register copies stay valid after it. */
+#define TCG_CALL_NO_WRITE_GLOBALS 0x0040
 
 /* used to align parameters */
 #define TCG_CALL_DUMMY_TCGV     MAKE_TCGV_I32(-1)
@@ -323,6 +356,10 @@ struct TCGContext {
     TCGPool *pool_first, *pool_current;
     TCGLabel *labels;
     int nb_labels;
+#ifdef USE_QEMU_LDST_LABELS
+    TCGLabelQemuLdst *qemu_ldst_labels;
+    int nb_qemu_ldst_labels;
+#endif
     TCGTemp *temps; /* globals first, temps after */
     int nb_globals;
     int nb_temps;
@@ -494,6 +531,9 @@ enum {
     TCG_OPF_64BIT        = 0x08,
     /* Instruction is optional and not implemented by the host.  */
     TCG_OPF_NOT_PRESENT  = 0x10,
+    /* Instruction is a conditional branch: with TCG_OPF_BB_END, code
+       after it is still reached with the same register contents.  */
+    TCG_OPF_COND_BRANCH  = 0x20,
 };
 
 typedef struct TCGOpDef {
@@ -532,6 +572,7 @@ void tcg_add_target_add_op_defs(const TCGTargetOpDef *tdefs);
 #define tcg_global_mem_new_ptr(R, O, N) \
     TCGV_NAT_TO_PTR(tcg_global_mem_new_i32((R), (O), (N)))
 #define tcg_temp_new_ptr() TCGV_NAT_TO_PTR(tcg_temp_new_i32())
+#define tcg_temp_local_new_ptr() TCGV_NAT_TO_PTR(tcg_temp_local_new_i32())
 #define tcg_temp_free_ptr(T) tcg_temp_free_i32(TCGV_PTR_TO_NAT(T))
 #else
 #define TCGV_NAT_TO_PTR(n) MAKE_TCGV_PTR(GET_TCGV_I64(n))
@@ -543,6 +584,7 @@ void tcg_add_target_add_op_defs(const TCGTargetOpDef *tdefs);
 #define tcg_global_mem_new_ptr(R, O, N) \
     TCGV_NAT_TO_PTR(tcg_global_mem_new_i64((R), (O), (N)))
 #define tcg_temp_new_ptr() TCGV_NAT_TO_PTR(tcg_temp_new_i64())
+#define tcg_temp_local_new_ptr() TCGV_NAT_TO_PTR(tcg_temp_local_new_i64())
 #define tcg_temp_free_ptr(T) tcg_temp_free_i64(TCGV_PTR_TO_NAT(T))
 #endif
 
@@ -40,6 +40,21 @@ struct memmap_entry {
 	int sk_idx;
 };
 
+/*
+ * Address decoding is done through a table of map indexes kept sorted by
+ * base address and searched with a binary search. On top of that, every
+ * initiator remembers the last entry it hit, as CPUs tend to hammer the
+ * same slave for long stretches. The cost of routing a transaction is
+ * thus independent of the number of slaves.
+ *
+ * Granted DMI regions are cached (in interconnect addresses) so that
+ * repeated DMI requests into an already granted area don't need to be
+ * forwarded. The cache holds disjoint regions sorted by start address and
+ * is binary searched like the decode table. A cached region is only
+ * handed out if it grants the access the request asks for. Adjacent
+ * regions backed by contiguous host memory with equal access rights and
+ * latencies are merged into a single one.
+ */
 template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
 class iconnect
 : public sc_core::sc_module
@@ -71,15 +86,37 @@ public:
 	int memmap(sc_dt::uint64 addr, sc_dt::uint64 size,
 		enum addrmode addrmode, int idx, tlm::tlm_target_socket<> &s);
 private:
-	unsigned int map_address(sc_dt::uint64 addr, sc_dt::uint64& offset);
+	/* Map indexes sorted by base address.  */
+	unsigned int decode[N_TARGETS * 4];
+	unsigned int nr_decode;
+	/* Per initiator index of the last hit map entry, -1 if none.  */
+	int last_hit[N_INITIATORS];
+
+	/* Disjoint DMI regions sorted by start address.  */
+	tlm::tlm_dmi dmi_cache[N_TARGETS * 4];
+	unsigned int nr_dmi_cache;
+	/* Next entry to evict when the cache is full.  */
+	unsigned int dmi_victim;
+
+	bool map_hit(unsigned int i, sc_dt::uint64 addr);
+	int lookup_map(sc_dt::uint64 addr);
+	unsigned int map_address(int id, sc_dt::uint64 addr,
+				sc_dt::uint64& offset);
 	void unmap_offset(unsigned int target_nr,
 				sc_dt::uint64 offset, sc_dt::uint64& addr);
 
+	unsigned int dmi_cache_bound(sc_dt::uint64 addr);
+	bool dmi_cache_lookup(sc_dt::uint64 addr, tlm::tlm_command cmd,
+				tlm::tlm_dmi& dmi_data);
+	bool dmi_mergeable(const tlm::tlm_dmi& lo, const tlm::tlm_dmi& hi);
+	void dmi_cache_remove(unsigned int i);
+	void dmi_cache_insert(const tlm::tlm_dmi& dmi_data);
+	void dmi_cache_invalidate(sc_dt::uint64 start, sc_dt::uint64 end);
 };
 
 template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
 iconnect<N_INITIATORS, N_TARGETS>::iconnect (sc_module_name name)
-	: sc_module(name)
+	: sc_module(name), nr_decode(0), nr_dmi_cache(0), dmi_victim(0)
 {
 	char txt[32];
 	unsigned int i;
@@ -93,6 +130,7 @@ iconnect<N_INITIATORS, N_TARGETS>::iconnect (sc_module_name name)
 		t_sk[i]->register_transport_dbg(this, &iconnect::transport_dbg, i);
 		t_sk[i]->register_get_direct_mem_ptr(this,
 				&iconnect::get_direct_mem_ptr, i);
+		last_hit[i] = -1;
 	}
 
 	for (i = 0; i < N_TARGETS; i++) {
@@ -101,6 +139,9 @@ iconnect<N_INITIATORS, N_TARGETS>::iconnect (sc_module_name name)
 
 		i_sk[i]->register_invalidate_direct_mem_ptr(this,
 				&iconnect::invalidate_direct_mem_ptr, i);
+	}
+
+	for (i = 0; i < N_TARGETS * 4; i++) {
 		map[i].size = 0;
 	}
 }
@@ -111,50 +152,106 @@ int iconnect<N_INITIATORS, N_TARGETS>::memmap(
 		enum addrmode addrmode, int idx,
 		tlm::tlm_target_socket<> &s)
 {
-	unsigned int i;
+	unsigned int i, pos;
 
 	for (i = 0; i < N_TARGETS * 4; i++) {
 		if (map[i].size == 0) {
-			/* Found a free entry.  */
-			map[i].addr = addr;
-			map[i].size = size;
-			map[i].addrmode = addrmode;
-			map[i].sk_idx = i;
-			if (idx == -1)
-				i_sk[i]->bind(s);
-			else
-				map[i].sk_idx = idx;
-			return i;
+			break;
+		}
+	}
+
+	if (i == N_TARGETS * 4 || (idx == -1 && i >= N_TARGETS)) {
+		printf("FATAL! mapping onto full interconnect!\n");
+		abort();
+		return -1;
+	}
+
+	/* Found a free entry.  */
+	map[i].addr = addr;
+	map[i].size = size;
+	map[i].addrmode = addrmode;
+	map[i].sk_idx = i;
+	if (idx == -1)
+		i_sk[i]->bind(s);
+	else
+		map[i].sk_idx = idx;
+
+	/* Insert it into the decode table, keeping it sorted.  */
+	pos = nr_decode;
+	while (pos > 0 && map[decode[pos - 1]].addr > addr) {
+		decode[pos] = decode[pos - 1];
+		pos--;
+	}
+	decode[pos] = i;
+	nr_decode++;
+
+	if ((pos > 0 && map_hit(decode[pos - 1], addr))
+	    || (pos + 1 < nr_decode
+		&& map[decode[pos + 1]].addr - addr < size)) {
+		printf("iconnect: overlapping mapping at %lx\n",
+			(unsigned long) addr);
+	}
+	return i;
+}
+
+template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
+inline bool iconnect<N_INITIATORS, N_TARGETS>::map_hit(unsigned int i,
+						sc_dt::uint64 addr)
+{
+	return addr >= map[i].addr && addr - map[i].addr < map[i].size;
+}
+
+/*
+ * Binary search the decode table for the entry covering addr.
+ * Returns the map index or -1 if nothing is mapped at addr.
+ */
+template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
+int iconnect<N_INITIATORS, N_TARGETS>::lookup_map(sc_dt::uint64 addr)
+{
+	unsigned int lo = 0, hi = nr_decode;
+
+	/* Find the first entry with a base above addr.  */
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (map[decode[mid]].addr <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
 		}
 	}
-	printf("FATAL! mapping onto full interconnect!\n");
-	abort();
+
+	/* The candidate is the one before it.  */
+	if (lo > 0 && map_hit(decode[lo - 1], addr)) {
+		return decode[lo - 1];
+	}
 	return -1;
 }
 
 template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
-unsigned int iconnect<N_INITIATORS, N_TARGETS>::map_address(
+unsigned int iconnect<N_INITIATORS, N_TARGETS>::map_address(int id,
 			sc_dt::uint64 addr,
 			sc_dt::uint64& offset)
 {
-	unsigned int i;
-
-	for (i = 0; i < N_TARGETS * 4; i++) {
-		if (map[i].size
-		    && addr >= map[i].addr
-		    && addr <= (map[i].addr + map[i].size)) {
-			if (map[i].addrmode == ADDRMODE_RELATIVE) {
-				offset = addr - map[i].addr;
-			} else {
-				offset = addr;
-			}
-			return map[i].sk_idx;
+	int i;
+
+	i = last_hit[id];
+	if (i < 0 || !map_hit(i, addr)) {
+		i = lookup_map(addr);
+		if (i < 0) {
+			/* Did not find any slave !?!?  */
+			printf("DECODE ERROR! %lx\n", (unsigned long) addr);
+			return 0;
 		}
+		last_hit[id] = i;
 	}
 
-	/* Did not find any slave !?!?  */
-        printf("DECODE ERROR! %lx\n", (unsigned long) addr);
-	return 0;
+	if (map[i].addrmode == ADDRMODE_RELATIVE) {
+		offset = addr - map[i].addr;
+	} else {
+		offset = addr;
+	}
+	return map[i].sk_idx;
 }
 
 template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
@@ -180,6 +277,136 @@ void iconnect<N_INITIATORS, N_TARGETS>::unmap_offset(
 	return;
 }
 
+/*
+ * Binary search the DMI cache for the first region starting above addr.
+ */
+template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
+unsigned int iconnect<N_INITIATORS, N_TARGETS>::dmi_cache_bound(
+			sc_dt::uint64 addr)
+{
+	unsigned int lo = 0, hi = nr_dmi_cache;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (dmi_cache[mid].get_start_address() <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
+bool iconnect<N_INITIATORS, N_TARGETS>::dmi_cache_lookup(
+			sc_dt::uint64 addr, tlm::tlm_command cmd,
+			tlm::tlm_dmi& dmi_data)
+{
+	unsigned int i = dmi_cache_bound(addr);
+
+	/* The candidate is the one before it.  */
+	if (i == 0 || addr > dmi_cache[i - 1].get_end_address()) {
+		return false;
+	}
+	i--;
+
+	/* Let the target decide about accesses it did not grant.  */
+	if ((cmd == tlm::TLM_READ_COMMAND && !dmi_cache[i].is_read_allowed())
+	    || (cmd == tlm::TLM_WRITE_COMMAND
+		&& !dmi_cache[i].is_write_allowed())) {
+		return false;
+	}
+	dmi_data = dmi_cache[i];
+	return true;
+}
+
+/*
+ * Can region hi be appended to region lo?
+ */
+template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
+bool iconnect<N_INITIATORS, N_TARGETS>::dmi_mergeable(
+			const tlm::tlm_dmi& lo, const tlm::tlm_dmi& hi)
+{
+	return lo.get_granted_access() == hi.get_granted_access()
+		&& lo.get_read_latency() == hi.get_read_latency()
+		&& lo.get_write_latency() == hi.get_write_latency()
+		&& lo.get_end_address() + 1 == hi.get_start_address()
+		&& lo.get_dmi_ptr()
+			+ (lo.get_end_address() - lo.get_start_address() + 1)
+			== hi.get_dmi_ptr();
+}
+
+template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
+void iconnect<N_INITIATORS, N_TARGETS>::dmi_cache_remove(unsigned int i)
+{
+	for (; i + 1 < nr_dmi_cache; i++) {
+		dmi_cache[i] = dmi_cache[i + 1];
+	}
+	nr_dmi_cache--;
+}
+
+template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
+void iconnect<N_INITIATORS, N_TARGETS>::dmi_cache_insert(
+			const tlm::tlm_dmi& dmi_data)
+{
+	unsigned int i, pos;
+
+	/* Whatever the new region overlaps is stale.  */
+	dmi_cache_invalidate(dmi_data.get_start_address(),
+				dmi_data.get_end_address());
+
+	pos = dmi_cache_bound(dmi_data.get_start_address());
+
+	/* Contiguous with a neighbour, merge them.  */
+	if (pos > 0 && dmi_mergeable(dmi_cache[pos - 1], dmi_data)) {
+		dmi_cache[pos - 1].set_end_address(dmi_data.get_end_address());
+		if (pos < nr_dmi_cache
+		    && dmi_mergeable(dmi_cache[pos - 1], dmi_cache[pos])) {
+			dmi_cache[pos - 1].set_end_address(
+					dmi_cache[pos].get_end_address());
+			dmi_cache_remove(pos);
+		}
+		return;
+	}
+	if (pos < nr_dmi_cache && dmi_mergeable(dmi_data, dmi_cache[pos])) {
+		dmi_cache[pos].set_dmi_ptr(dmi_data.get_dmi_ptr());
+		dmi_cache[pos].set_start_address(dmi_data.get_start_address());
+		return;
+	}
+
+	if (nr_dmi_cache == N_TARGETS * 4) {
+		/* Full, recycle one in round robin order.  */
+		i = dmi_victim++ % nr_dmi_cache;
+		dmi_cache_remove(i);
+		if (i < pos) {
+			pos--;
+		}
+	}
+
+	for (i = nr_dmi_cache; i > pos; i--) {
+		dmi_cache[i] = dmi_cache[i - 1];
+	}
+	dmi_cache[pos] = dmi_data;
+	nr_dmi_cache++;
+}
+
+template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
+void iconnect<N_INITIATORS, N_TARGETS>::dmi_cache_invalidate(
+			sc_dt::uint64 start, sc_dt::uint64 end)
+{
+	unsigned int i = 0;
+
+	while (i < nr_dmi_cache) {
+		if (start <= dmi_cache[i].get_end_address()
+		    && end >= dmi_cache[i].get_start_address()) {
+			dmi_cache_remove(i);
+		} else {
+			i++;
+		}
+	}
+}
+
 template<unsigned int N_INITIATORS, unsigned int N_TARGETS>
 void iconnect<N_INITIATORS, N_TARGETS>::b_transport(int id,
 			tlm::tlm_generic_payload& trans, sc_time& delay)
@@ -193,7 +420,7 @@ void iconnect<N_INITIATORS, N_TARGETS>::b_transport(int id,
 	}
 
 	addr = trans.get_address();
-	target_nr = map_address(addr, offset);
+	target_nr = map_address(id, addr, offset);
 
 	trans.set_address(offset);
 	/* Forward the transaction.  */
@@ -217,16 +444,25 @@ bool iconnect<N_INITIATORS, N_TARGETS>::get_direct_mem_ptr(int id,
 	}
 
 	addr = trans.get_address();
-	target_nr = map_address(addr, offset);
+	if (dmi_cache_lookup(addr, trans.get_command(), dmi_data)) {
+		return true;
+	}
+
+	target_nr = map_address(id, addr, offset);
 
 	trans.set_address(offset);
 	/* Forward the transaction.  */
 	r = (*i_sk[target_nr])->get_direct_mem_ptr(trans, dmi_data);
+	trans.set_address(addr);
 
 	unmap_offset(target_nr, dmi_data.get_start_address(), addr);
 	dmi_data.set_start_address(addr);
 	unmap_offset(target_nr, dmi_data.get_end_address(), addr);
 	dmi_data.set_end_address(addr);
+
+	if (r) {
+		dmi_cache_insert(dmi_data);
+	}
 	return r;
 }
 
@@ -243,7 +479,7 @@ unsigned int iconnect<N_INITIATORS, N_TARGETS>::transport_dbg(int id,
 	}
 
 	addr = trans.get_address();
-	target_nr = map_address(addr, offset);
+	target_nr = map_address(id, addr, offset);
 
 	trans.set_address(offset);
 	/* Forward the transaction.  */
@@ -264,6 +500,8 @@ void iconnect<N_INITIATORS, N_TARGETS>::invalidate_direct_mem_ptr(int id,
 	unmap_offset(id, start_range, start);
 	unmap_offset(id, end_range, end);
 
+	dmi_cache_invalidate(start, end);
+
 	for (i = 0; i < N_INITIATORS; i++) {
 		(*t_sk[i])->invalidate_direct_mem_ptr(start, end);
 	}
@@ -56,6 +56,7 @@ tlmu_sc::tlmu_sc(sc_module_name name, const char *soname,
 	  elf_filename(elf_filename),
 	  tracing(tracing),
 	  gdb_conn(gdb_conn),
+	  max_posted(0),
 	  is_running(false)
 {
 	int err;
@@ -109,28 +110,57 @@ void tlmu_sc::set_image_load_params(uint64_t base, uint64_t size)
 	tlmu_set_image_load_params(&q, base, size);
 }
 
-void tlmu_sc::sync_time(int64_t tlmu_time_ns)
+/*
+ * Account for the time elapsed in TLMu as local time, without yielding
+ * to the SystemC kernel.
+ */
+void tlmu_sc::annotate_time(int64_t tlmu_time_ns)
 {
+	double delta_ns;
+
 	/* Did QEMU provide a valid time ?  */
-	if (tlmu_time_ns != -1) {
-		double delta_ns;
-		delta_ns = tlmu_time_ns - last_sync;
-		last_sync = tlmu_time_ns;
-
-		/* We run QEMU with -icount 1, meaning QEMU will execute
-		   one insn every 2ns (2^N where N is the icount value).
-		   Here we transform delta_ns into a 1Ghz CPU freq.  */
-		delta_ns /= 2;
-
-		/* Now scale it according to the request freq.  */
-		delta_ns *= speed_factor;
-		m_qk.inc(sc_time(delta_ns, SC_NS));
+	if (tlmu_time_ns == -1) {
+		return;
 	}
-	if (m_qk.need_sync()) {
+
+	delta_ns = tlmu_time_ns - last_sync;
+	last_sync = tlmu_time_ns;
+
+	/* We run QEMU with -icount 1, meaning QEMU will execute
+	   one insn every 2ns (2^N where N is the icount value).
+	   Here we transform delta_ns into a 1Ghz CPU freq.  */
+	delta_ns /= 2;
+
+	/* Now scale it according to the request freq.  */
+	delta_ns *= speed_factor;
+	m_qk.inc(sc_time(delta_ns, SC_NS));
+}
+
+/*
+ * Account for the time elapsed in TLMu and yield to the SystemC kernel
+ * when the quantum has been used up, or when explicitly asked to (force).
+ */
+void tlmu_sc::sync_time(int64_t tlmu_time_ns, bool force)
+{
+	annotate_time(tlmu_time_ns);
+	if (force || m_qk.need_sync()) {
+		flush_posted();
 		m_qk.sync();
 	}
 }
 
+bool tlmu_sc::is_sync_addr(uint64_t addr)
+{
+	std::vector<std::pair<uint64_t, uint64_t> >::iterator it;
+
+	for (it = sync_regions.begin(); it != sync_regions.end(); it++) {
+		if (addr >= it->first && addr - it->first < it->second) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void tlmu_sc::get_dmi_ptr(uint64_t addr, struct tlmu_dmi *dmi)
 {
 	tlm::tlm_generic_payload tr;
@@ -182,6 +212,7 @@ int tlmu_sc::bus_access(int64_t clk, int rw,
 {
 	tlm::tlm_generic_payload tr;
 	sc_time delay;
+	bool sync_now;
 
 #if 0
 	printf("%s: rw=%d addr=%lx len=%d data=%x\n", __func__,
@@ -195,9 +226,18 @@ int tlmu_sc::bus_access(int64_t clk, int rw,
 	tr.set_dmi_allowed(false);
 	tr.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
 
-	/* Sync the QEMU time with TLM to let the target see the elapsed
-	   time from CPU execution.  */
-	sync_time(clk);
+	/* Let the target see the elapsed time from CPU execution as an
+	   annotated delay. The kernel is only yielded to at the quantum
+	   ends signalled by sync(), except for devices that asked to see
+	   the SystemC time fully in sync.  */
+	sync_now = !sync_regions.empty() && is_sync_addr(addr);
+	if (sync_now) {
+		sync_time(clk, true);
+	} else {
+		annotate_time(clk);
+	}
+	/* Earlier posted writes must hit the bus before this access.  */
+	flush_posted();
 	delay = m_qk.get_local_time();
 	from_tlmu_sk->b_transport(tr, delay);
 
@@ -205,10 +245,100 @@ int tlmu_sc::bus_access(int64_t clk, int rw,
 		tlmu_notify_event(&q, TLMU_TLM_EVENT_DEBUG_BREAK, 0);
 	}
 
-	m_qk.set_and_sync(delay);
+	m_qk.set(delay);
+	if (sync_now) {
+		m_qk.sync();
+	}
 	return tr.is_dmi_allowed();
 }
 
+/*
+ * Non-blocking bus access. Writes are queued and issued in bulk at the
+ * next sync point or blocking access, everything else is rejected and
+ * retried by TLMu as a blocking access.
+ */
+int tlmu_sc::bus_access_nb(int64_t clk, int rw,
+			uint64_t addr, void *data, int len)
+{
+	struct posted_write pw;
+
+	if (!rw || len > (int) sizeof pw.data
+	    || (!sync_regions.empty() && is_sync_addr(addr))) {
+		return TLMU_NB_REJECTED;
+	}
+
+	annotate_time(clk);
+	if (posted.size() >= max_posted) {
+		flush_posted();
+	}
+
+	pw.addr = addr;
+	pw.len = len;
+	pw.delay = m_qk.get_local_time();
+	memcpy(&pw.data, data, len);
+	posted.push_back(pw);
+	return TLMU_NB_ACCEPTED;
+}
+
+void tlmu_sc::flush_posted(void)
+{
+	tlm::tlm_generic_payload tr;
+	struct tlmu_bus_resp resp;
+
+	while (!posted.empty()) {
+		struct posted_write &pw = posted.front();
+		sc_time delay = pw.delay;
+
+		tr.set_command(tlm::TLM_WRITE_COMMAND);
+		tr.set_address(pw.addr);
+		tr.set_data_ptr((unsigned char *)&pw.data);
+		tr.set_data_length(pw.len);
+		tr.set_streaming_width(pw.len);
+		tr.set_byte_enable_ptr(NULL);
+		tr.set_dmi_allowed(false);
+		tr.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+
+		from_tlmu_sk->b_transport(tr, delay);
+
+		resp.addr = pw.addr;
+		resp.error = tr.get_response_status() != tlm::TLM_OK_RESPONSE;
+		posted.pop_front();
+		tlmu_notify_event(&q, TLMU_TLM_EVENT_BUS_COMPLETE, &resp);
+	}
+}
+
+/* Buffered writes to write-posting areas, one call per batch.  */
+int tlmu_sc::bus_access_batch(struct tlmu_bus_req *req, int nr)
+{
+	tlm::tlm_generic_payload tr;
+	sc_time delay;
+	int err = 0;
+	int i;
+
+	/* Writes queued through the non-blocking interface go first.  */
+	flush_posted();
+
+	tr.set_command(tlm::TLM_WRITE_COMMAND);
+	tr.set_byte_enable_ptr(NULL);
+	tr.set_dmi_allowed(false);
+	for (i = 0; i < nr; i++) {
+		annotate_time(req[i].clk);
+		delay = m_qk.get_local_time();
+
+		tr.set_address(req[i].addr);
+		tr.set_data_ptr((unsigned char *)&req[i].data);
+		tr.set_data_length(req[i].len);
+		tr.set_streaming_width(req[i].len);
+		tr.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+		from_tlmu_sk->b_transport(tr, delay);
+
+		if (tr.get_response_status() != tlm::TLM_OK_RESPONSE) {
+			err = 1;
+		}
+	}
+	return err;
+}
+
 void tlmu_sc::bus_access_dbg(int64_t clk, int rw,
 				uint64_t addr, void *data, int len)
 {
@@ -332,6 +462,62 @@ void tlmu_sc::map_ram(const char *name, uint64_t base, uint64_t size, int rw)
 	tlmu_map_ram(&q, name, base, size, rw);
 }
 
+/*
+ * Accesses to devices mapped at [base, base + size) will be preceded
+ * and followed by a sync with the SystemC kernel. Use it for devices that
+ * look at sc_time_stamp() and can't deal with annotated delays.
+ */
+void tlmu_sc::map_sync_region(uint64_t base, uint64_t size)
+{
+	sync_regions.push_back(std::make_pair(base, size));
+}
+
+/*
+ * Let TLMu post writes to devices. Posted writes don't stall the CPU,
+ * they get queued (max_queued at most) and issued at the next sync point.
+ * Reads and accesses to sync regions still block.
+ */
+void tlmu_sc::post_writes(unsigned int max_queued)
+{
+	sc_assert(!is_running);
+	max_posted = max_queued;
+	tlmu_set_bus_access_nb_cb(&q, &tlmu_sc::bus_access_nb);
+}
+
+/*
+ * Writes to [base, base + size) need no response and get buffered inside
+ * TLMu. They reach the bus in batches, in order, before any other access
+ * from this CPU and at sync points.
+ */
+void tlmu_sc::map_write_posting(uint64_t base, uint64_t size)
+{
+	map_region("posted", base, size, TLMU_REGION_WRITE_POSTING);
+}
+
+/*
+ * Describe how the area at [base, base + size) behaves, see the
+ * TLMU_REGION_* attributes in tlmu.h.
+ */
+void tlmu_sc::map_region(const char *name, uint64_t base, uint64_t size,
+			int attrs)
+{
+	sc_assert(!is_running);
+	if (attrs & TLMU_REGION_WRITE_POSTING) {
+		tlmu_set_bus_access_batch_cb(&q, &tlmu_sc::bus_access_batch);
+	}
+	tlmu_map_region(&q, name, base, size, attrs);
+}
+
+/* Drop any TLMu shadowed reads of a TLMU_REGION_READ_CACHE area.  */
+void tlmu_sc::invalidate_region_cache(uint64_t base, uint64_t size)
+{
+	struct tlmu_dmi range;
+
+	range.base = base;
+	range.size = size;
+	tlmu_notify_event(&q, TLMU_TLM_EVENT_INVALIDATE_CACHE, &range);
+}
+
 unsigned int tlmu_sc::irq_transport_dbg(tlm::tlm_generic_payload& trans)
 {
 	return 0;
@@ -340,6 +526,7 @@ unsigned int tlmu_sc::irq_transport_dbg(tlm::tlm_generic_payload& trans)
 void tlmu_sc::sync(int64_t time_ns)
 {
 	sync_time(time_ns);
+	flush_posted();
 }
 
 void tlmu_sc::wake(void)
@@ -24,6 +24,9 @@
 
 /* To Avoid warnings when declaring the funcion pointers accross C and C++.  */
 #define TLMU_NO_DECLARE_CB_FUNC_PTR
+#include <vector>
+#include <deque>
+#include <utility>
 extern "C" {
 #include "tlmu.h"
 };
@@ -60,6 +63,12 @@ public:
 		 int64_t sync_period_ns=-1);
 
 	void map_ram(const char *name, uint64_t base, uint64_t size, int rw);
+	void map_sync_region(uint64_t base, uint64_t size);
+	void post_writes(unsigned int max_queued=64);
+	void map_write_posting(uint64_t base, uint64_t size);
+	void map_region(const char *name, uint64_t base, uint64_t size,
+			int attrs);
+	void invalidate_region_cache(uint64_t base, uint64_t size);
 	void set_image_load_params(uint64_t base, uint64_t size);
 	void append_arg(const char *newarg);
 	void gdb(const char *gdb_conn, bool wait_for_gdb_at_start=true);
@@ -79,6 +88,18 @@ private:
 	const char *gdb_conn;
 	const char *bootsel;
 	bool use_global_quantum;  // set sync_period to global quantum
+	/* Areas that need the SystemC time in sync at every access.  */
+	std::vector<std::pair<uint64_t, uint64_t> > sync_regions;
+
+	/* Writes posted by TLMu, waiting to be issued.  */
+	struct posted_write {
+		uint64_t addr;
+		uint64_t data;
+		int len;
+		sc_core::sc_time delay;
+	};
+	std::deque<posted_write> posted;
+	unsigned int max_posted;
 	struct tlmu q;
 	bool is_running;
 	sc_core::sc_event start;
@@ -96,10 +117,16 @@ private:
 	void wait_started();
 	void start_of_simulation(void);
 	void process(void);
-	void sync_time(int64_t tlmu_time_ns);
+	void annotate_time(int64_t tlmu_time_ns);
+	void sync_time(int64_t tlmu_time_ns, bool force=false);
+	bool is_sync_addr(uint64_t addr);
 	void get_dmi_ptr(uint64_t addr, struct tlmu_dmi *dmi);
 	int bus_access(int64_t clk, int rw,
 				uint64_t addr, void *data, int len);
+	int bus_access_nb(int64_t clk, int rw,
+				uint64_t addr, void *data, int len);
+	void flush_posted(void);
+	int bus_access_batch(struct tlmu_bus_req *req, int nr);
 	void bus_access_dbg(int64_t clk, int rw,
 			uint64_t addr, void *data, int len);
 	void sync(int64_t time_ns);
@@ -116,6 +143,12 @@ void tlmu_set_bus_access_cb(struct tlmu *q,
 void tlmu_set_bus_access_dbg_cb(struct tlmu *q,
 			void (tlmu_sc::*access_debug)(int64_t clk, int rw,
                                 uint64_t addr, void *data, int len));
+void tlmu_set_bus_access_nb_cb(struct tlmu *q,
+			int (tlmu_sc::*access)(int64_t clk, int rw,
+				uint64_t addr, void *data, int len));
+void tlmu_set_bus_access_batch_cb(struct tlmu *q,
+			int (tlmu_sc::*access)(struct tlmu_bus_req *req,
+				int nr));
 void tlmu_set_bus_get_dmi_ptr_cb(struct tlmu *q,
 			void (tlmu_sc::*get_dmi_ptr)(uint64_t addr,
                                 struct tlmu_dmi *dmi));
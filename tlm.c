@@ -11,6 +11,14 @@ int (*tlm_bus_access_cb)(void *o, int64_t clk, int rw,
                           uint64_t addr, void *data, int len);
 void (*tlm_bus_access_dbg_cb)(void *o, int64_t clk, int rw, uint64_t addr,
                               void *data, int len);
+/* Optional non-blocking variant, used for posted writes. The callee must
+   take a copy of the data before returning TLMU_NB_ACCEPTED and later
+   notify the completion with a TLMU_TLM_EVENT_BUS_COMPLETE event.  */
+int (*tlm_bus_access_nb_cb)(void *o, int64_t clk, int rw,
+                            uint64_t addr, void *data, int len);
+/* Called with a batch of buffered writes to write-posting areas. Returns
+   non-zero if any of them failed.  */
+int (*tlm_bus_access_batch_cb)(void *o, struct tlmu_bus_req *req, int nr);
 
 void (*tlm_get_dmi_ptr_cb)(void *o, uint64_t addr,
                            struct tlmu_dmi *dmi) = 0;
@@ -37,8 +45,19 @@ int tlm_boot_state;
 uint64_t tlm_image_load_base = 0;
 uint64_t tlm_image_load_size = 0;
 
+void tlm_flush_posted_writes(void) __attribute__((weak));
+void tlm_flush_posted_writes(void)
+{
+}
+
 int tlm_iodev_is_ram(int iodev) __attribute__((weak));
 int tlm_iodev_is_ram(int iodev)
 {
     return 0;
 }
+
+int tlm_iodev_is_tlm(int iodev) __attribute__((weak));
+int tlm_iodev_is_tlm(int iodev)
+{
+    return 0;
+}
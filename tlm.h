@@ -6,6 +6,10 @@ extern int (*tlm_bus_access_cb)(void *o, int64_t clk, int rw,
 extern void (*tlm_bus_access_dbg_cb)(void *o, int64_t clk,
                                 int rw, uint64_t addr,
                                 void *data, int len);
+extern int (*tlm_bus_access_nb_cb)(void *o, int64_t clk, int rw,
+                                   uint64_t addr, void *data, int len);
+extern int (*tlm_bus_access_batch_cb)(void *o,
+                                      struct tlmu_bus_req *req, int nr);
 extern void (*tlm_get_dmi_ptr_cb)(void *o, uint64_t addr,
                                   struct tlmu_dmi *dmi);
 
@@ -24,6 +28,16 @@ extern void (*tlm_timer_start)(void *q, void *o,
 void tlm_map_ram(const char *name, uint64_t addr, uint64_t size, int rw);
 void tlm_register_rams(void);
 
+/* Used to describe how address areas behave, see TLMU_REGION_*. RAM and
+   executable areas get mapped as RAMs, the rest stay on the bus but get
+   the fastest access path their attributes allow.  */
+void tlm_map_region(const char *name, uint64_t addr, uint64_t size, int attrs);
+
+/* Writes to write-posting areas are buffered and passed to the main
+   emulator in batches. The buffer gets flushed before any other bus
+   access leaves QEMU, at sync points and when it fills up.  */
+void tlm_flush_posted_writes(void);
+
 extern uint64_t tlm_sync_period_ns;
 
 extern void tlm_notify_event(enum tlmu_event ev, void *d);
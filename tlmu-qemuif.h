@@ -12,6 +12,40 @@ enum tlmu_event {
     TLMU_TLM_EVENT_INVALIDATE_DMI,
     TLMU_TLM_EVENT_RESET,
     TLMU_TLM_EVENT_DEBUG_BREAK,
+    TLMU_TLM_EVENT_BUS_COMPLETE,
+    TLMU_TLM_EVENT_INVALIDATE_CACHE,
+};
+
+/* Region attributes, see tlmu_map_region().  */
+enum {
+    TLMU_REGION_NONE = 0,
+    TLMU_REGION_RAM = 1,           /* Behaves like memory.  */
+    TLMU_REGION_EXEC = 2,          /* Code may be executed from it.  */
+    TLMU_REGION_READ_CACHE = 4,    /* Reads may be served from a shadow.  */
+    TLMU_REGION_IDEMPOTENT = 8,    /* Accesses have no side-effects.  */
+    TLMU_REGION_WRITE_POSTING = 16,/* Writes need no response.  */
+};
+
+/* Return values for the non-blocking bus access callback.  */
+enum {
+    TLMU_NB_REJECTED = 0,        /* Not taken, retry as a blocking access.  */
+    TLMU_NB_ACCEPTED = 1,        /* Queued, completion notified later.  */
+};
+
+/* A buffered write, see tlmu_set_bus_access_batch_cb().  */
+struct tlmu_bus_req
+{
+    int64_t clk;                 /* TLMu time when the write was made.  */
+    uint64_t addr;               /* Target address.  */
+    uint64_t data;               /* Data, the first len bytes are valid.  */
+    int len;                     /* Access length.  */
+};
+
+/* Passed with TLMU_TLM_EVENT_BUS_COMPLETE.  */
+struct tlmu_bus_resp
+{
+    uint64_t addr;               /* Address of the completed access.  */
+    int error;                   /* Non-zero if the access failed.  */
 };
 
 
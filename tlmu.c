@@ -323,6 +323,7 @@ int tlmu_load(struct tlmu *q, const char *soname)
 	q->tlm_image_load_base = dlsym(q->dl_handle, "tlm_image_load_base");
 	q->tlm_image_load_size = dlsym(q->dl_handle, "tlm_image_load_size");
 	q->tlm_map_ram = dlsym(q->dl_handle, "tlm_map_ram");
+	q->tlm_map_region = dlsym(q->dl_handle, "tlm_map_region");
 	q->tlm_opaque = dlsym(q->dl_handle, "tlm_opaque");
 	q->tlm_notify_event = dlsym(q->dl_handle, "tlm_notify_event");
 	q->tlm_timer_opaque = dlsym(q->dl_handle, "tlm_timer_opaque");
@@ -332,6 +333,9 @@ int tlmu_load(struct tlmu *q, const char *soname)
 	q->tlm_boot_state = dlsym(q->dl_handle, "tlm_boot_state");
 	q->tlm_bus_access_cb = dlsym(q->dl_handle, "tlm_bus_access_cb");
 	q->tlm_bus_access_dbg_cb = dlsym(q->dl_handle, "tlm_bus_access_dbg_cb");
+	q->tlm_bus_access_nb_cb = dlsym(q->dl_handle, "tlm_bus_access_nb_cb");
+	q->tlm_bus_access_batch_cb = dlsym(q->dl_handle,
+					"tlm_bus_access_batch_cb");
 	q->tlm_bus_access = dlsym(q->dl_handle, "tlm_bus_access");
 	q->tlm_bus_access_dbg = dlsym(q->dl_handle, "tlm_bus_access_dbg");
 	q->tlm_get_dmi_ptr_cb = dlsym(q->dl_handle, "tlm_get_dmi_ptr_cb");
@@ -339,6 +343,7 @@ int tlmu_load(struct tlmu *q, const char *soname)
 	tlmu_set_timer_start_cb(q, q, tlmu_timer_start);
 	if (!q->main
 		|| !q->tlm_map_ram
+		|| !q->tlm_map_region
 		|| !q->tlm_set_log_filename
 		|| !q->tlm_image_load_base
 		|| !q->tlm_image_load_size
@@ -350,6 +355,8 @@ int tlmu_load(struct tlmu *q, const char *soname)
 		|| !q->tlm_boot_state
 		|| !q->tlm_bus_access_cb
 		|| !q->tlm_bus_access_dbg_cb
+		|| !q->tlm_bus_access_nb_cb
+		|| !q->tlm_bus_access_batch_cb
 		|| !q->tlm_bus_access
 		|| !q->tlm_bus_access_dbg
 		|| !q->tlm_get_dmi_ptr_cb
@@ -389,6 +396,18 @@ void tlmu_set_bus_access_dbg_cb(struct tlmu *q,
 	*q->tlm_bus_access_dbg_cb = access;
 }
 
+void tlmu_set_bus_access_nb_cb(struct tlmu *q,
+		int (*access)(void *, int64_t, int, uint64_t, void *, int))
+{
+	*q->tlm_bus_access_nb_cb = access;
+}
+
+void tlmu_set_bus_access_batch_cb(struct tlmu *q,
+		int (*access)(void *, struct tlmu_bus_req *, int))
+{
+	*q->tlm_bus_access_batch_cb = access;
+}
+
 void tlmu_set_bus_get_dmi_ptr_cb(struct tlmu *q,
 			void (*dmi)(void *, uint64_t, struct tlmu_dmi*))
 {
@@ -439,6 +458,17 @@ void tlmu_map_ram(struct tlmu *q, const char *name,
 	q->tlm_map_ram(name, addr, size, rw);
 }
 
+void tlmu_map_region(struct tlmu *q, const char *name,
+		uint64_t addr, uint64_t size, int attrs)
+{
+	q->tlm_map_region(name, addr, size, attrs);
+}
+
+void tlmu_map_write_posting(struct tlmu *q, uint64_t addr, uint64_t size)
+{
+	q->tlm_map_region("posted", addr, size, TLMU_REGION_WRITE_POSTING);
+}
+
 void tlmu_set_log_filename(struct tlmu *q, const char *f)
 {
 	q->tlm_set_log_filename(f);
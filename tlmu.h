@@ -52,6 +52,8 @@ struct tlmu
 
 	void (*tlm_map_ram)(const char *name,
 			    uint64_t addr, uint64_t size, int rw);
+	void (*tlm_map_region)(const char *name,
+			    uint64_t addr, uint64_t size, int attrs);
 	void **tlm_opaque;
 	void **tlm_timer_opaque;
 	uint64_t *tlm_image_load_base;
@@ -68,6 +70,10 @@ struct tlmu
 				uint64_t addr, void *data, int len);
 	void (**tlm_bus_access_dbg_cb)(void *o, int64_t clk,
 			int rw, uint64_t addr, void *data, int len);
+	int (**tlm_bus_access_nb_cb)(void *o, int64_t clk,
+			int rw, uint64_t addr, void *data, int len);
+	int (**tlm_bus_access_batch_cb)(void *o,
+			struct tlmu_bus_req *req, int nr);
 	int (*tlm_bus_access)(int rw, uint64_t addr, void *data, int len);
 	void (*tlm_bus_access_dbg)(int rw,
 				uint64_t addr, void *data, int len);
@@ -128,6 +134,35 @@ void tlmu_set_bus_access_cb(struct tlmu *t,
  */
 void tlmu_set_bus_access_dbg_cb(struct tlmu *t,
 		void (*access)(void *, int64_t, int, uint64_t, void *, int));
+/*
+ * Register an optional non-blocking bus access callback. When registered,
+ * TLMu will try it for write accesses to devices before falling back to
+ * the blocking bus_access callback. Reads always block.
+ *
+ * The callback takes the same arguments as the blocking one. It returns
+ * TLMU_NB_ACCEPTED if the access got queued, in which case it must have
+ * made a copy of the data. The completion is later acknowledged by
+ * notifying a TLMU_TLM_EVENT_BUS_COMPLETE event with a struct
+ * tlmu_bus_resp. Queued writes must be carried out before any later
+ * blocking access from the same TLMu instance, to preserve ordering.
+ *
+ * Returning TLMU_NB_REJECTED makes TLMu retry with a blocking access.
+ */
+void tlmu_set_bus_access_nb_cb(struct tlmu *t,
+		int (*access)(void *, int64_t, int, uint64_t, void *, int));
+/*
+ * Register a callback to receive buffered writes to write-posting areas,
+ * see tlmu_map_write_posting().
+ *
+ * In the callback:
+ *  o          - Is the registered instance pointer, see tlm_set_opaque().
+ *  req        - Array of writes, in the order they were made.
+ *  nr         - Number of writes.
+ *
+ * The callback is expected to return non-zero if any of the writes failed.
+ */
+void tlmu_set_bus_access_batch_cb(struct tlmu *t,
+		int (*access)(void *, struct tlmu_bus_req *, int));
 /*
  * Register a callback to be called when the TLMu emulator requests a
  * Direct Memory Interface (DMI) area.
@@ -170,6 +205,48 @@ void tlmu_set_timer_start_cb(struct tlmu *t, void *o,
  */
 void tlmu_map_ram(struct tlmu *t, const char *name,
                 uint64_t addr, uint64_t size, int rw);
+/*
+ * Tell the TLMu instance that writes to a given area need no response
+ * and may be posted. Such writes are buffered and passed in batches to
+ * the callback registered with tlmu_set_bus_access_batch_cb(). The
+ * buffer is flushed before any other bus access, at sync points, and
+ * when it fills up, so ordering is preserved.
+ *
+ * Has no effect unless a batch callback is registered. Same as
+ * tlmu_map_region() with TLMU_REGION_WRITE_POSTING only.
+ *
+ * t         - The TLMu instance
+ * addr      - Base address
+ * size      - Size of the area
+ */
+void tlmu_map_write_posting(struct tlmu *t, uint64_t addr, uint64_t size);
+/*
+ * Tell the TLMu instance how a given memory area behaves, so that the
+ * fastest legal access path can be used for it. Must be called before
+ * tlmu_run().
+ *
+ * t         - The TLMu instance
+ * name      - A name for the area
+ * addr      - Base address
+ * size      - Size of the area
+ * attrs     - A mask of TLMU_REGION_* attributes:
+ *
+ *  TLMU_REGION_RAM            - The area behaves like RAM. Same as
+ *                               tlmu_map_ram with rw set.
+ *  TLMU_REGION_EXEC           - Code may execute from the area. Without
+ *                               TLMU_REGION_RAM it gets mapped as a ROM,
+ *                               writes still reach the bus.
+ *  TLMU_REGION_READ_CACHE     - Reads may be served from a local shadow
+ *                               copy until invalidated, see
+ *                               TLMU_TLM_EVENT_INVALIDATE_CACHE. Writes
+ *                               into the area drop the shadowed bytes.
+ *  TLMU_REGION_IDEMPOTENT     - Accesses have no side-effects. DMI accesses
+ *                               to the area don't force a sync.
+ *  TLMU_REGION_WRITE_POSTING  - Writes need no response, see
+ *                               tlmu_map_write_posting().
+ */
+void tlmu_map_region(struct tlmu *t, const char *name,
+		uint64_t addr, uint64_t size, int attrs);
 /*
  * Set the per TLMu instance log filename.
  *
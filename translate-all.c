@@ -161,3 +161,37 @@ int cpu_restore_state(TranslationBlock *tb,
 #endif
     return 0;
 }
+
+/* Return the number of guest instructions in 'tb' that precede the one
+   at host address 'searched_pc', or -1 if not found. Unlike
+   cpu_restore_state, the CPU state is left untouched.  */
+int cpu_restore_icount(TranslationBlock *tb,
+                       CPUState *env, unsigned long searched_pc)
+{
+    TCGContext *s = &tcg_ctx;
+    int j;
+    unsigned long tc_ptr;
+
+    tcg_func_start(s);
+
+    gen_intermediate_code_pc(env, tb);
+
+    tc_ptr = (unsigned long)tb->tc_ptr;
+    if (searched_pc < tc_ptr)
+        return -1;
+
+    s->tb_next_offset = tb->tb_next_offset;
+#ifdef USE_DIRECT_JUMP
+    s->tb_jmp_offset = tb->tb_jmp_offset;
+    s->tb_next = NULL;
+#else
+    s->tb_jmp_offset = NULL;
+    s->tb_next = tb->tb_next;
+#endif
+    j = tcg_gen_code_search_pc(s, (uint8_t *)tc_ptr, searched_pc - tc_ptr);
+    if (j < 0)
+        return -1;
+    while (gen_opc_instr_start[j] == 0)
+        j--;
+    return gen_opc_icount[j];
+}
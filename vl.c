@@ -161,6 +161,7 @@ int main(int argc, char **argv)
 #include "trace/control.h"
 #include "qemu-queue.h"
 #include "cpus.h"
+#include "qemu-stats.h"
 #include "arch_init.h"
 
 #include "ui/qemu-spice.h"
@@ -180,9 +181,10 @@ int display_remote = 0;
 const char* keyboard_layout = NULL;
 ram_addr_t ram_size;
 const char *mem_path = NULL;
-#ifdef MAP_POPULATE
 int mem_prealloc = 0; /* force preallocation of physical target memory */
-#endif
+int mem_hugepage = 0;
+int mem_shared = 0;
+int mem_host_node = -1;
 int nb_nics;
 NICInfo nd_table[MAX_NICS];
 int vm_running;
@@ -1498,10 +1500,17 @@ static void main_loop(void)
                 break;
         }
         if (qemu_reset_requested()) {
-            pause_all_vcpus();
-            cpu_synchronize_all_states();
-            qemu_system_reset(VMRESET_REPORT);
-            resume_all_vcpus();
+            /* The images a reset copies in are no longer the loaded ones.  */
+            if (rom_check_mappings() < 0) {
+                fprintf(stderr, "reset refused, restart to load the new "
+                        "images\n");
+                vm_stop(VMSTOP_PANIC);
+            } else {
+                pause_all_vcpus();
+                cpu_synchronize_all_states();
+                qemu_system_reset(VMRESET_REPORT);
+                resume_all_vcpus();
+            }
         }
         if (qemu_powerdown_requested()) {
             monitor_protocol_event(QEVENT_POWERDOWN, NULL);
@@ -2033,6 +2042,32 @@ static struct {
     { "kvm", "KVM", kvm_available, kvm_init, &kvm_allowed },
 };
 
+static void configure_ram_policy(void)
+{
+#ifdef MAP_POPULATE
+    QemuOptsList *list = qemu_find_opts("machine");
+    QemuOpts *opts;
+    uint64_t node;
+
+    opts = QTAILQ_FIRST(&list->head);
+    if (!opts) {
+        return;
+    }
+    mem_hugepage = qemu_opt_get_bool(opts, "mem-hugepage", mem_hugepage);
+    mem_prealloc = qemu_opt_get_bool(opts, "mem-prealloc", mem_prealloc);
+    mem_shared = qemu_opt_get_bool(opts, "mem-shared", mem_shared);
+    node = qemu_opt_get_number(opts, "mem-host-node", (uint64_t)-1);
+    if (node != (uint64_t)-1) {
+        if (node >= sizeof(unsigned long) * 8) {
+            fprintf(stderr, "mem-host-node: node %" PRIu64 " out of range\n",
+                    node);
+            exit(1);
+        }
+        mem_host_node = node;
+    }
+#endif
+}
+
 static int configure_accelerator(void)
 {
     const char *p = NULL;
@@ -3179,6 +3214,7 @@ int vl_main(int ignore_sigint, int no_sdl, int no_gui_timer,
     }
 
     configure_accelerator();
+    configure_ram_policy();
 
     if (qemu_init_main_loop()) {
         fprintf(stderr, "qemu_init_main_loop failed\n");
@@ -3223,6 +3259,7 @@ int vl_main(int ignore_sigint, int no_sdl, int no_gui_timer,
     cpu_exec_init_all();
 
     bdrv_init_with_whitelist();
+    qemu_stats_register("block", bdrv_stats_snapshot, NULL);
 
     blk_mig_init();
 